@@ -0,0 +1,46 @@
+#include "access_sketch.hpp"
+#include "hash.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <limits>
+
+namespace {
+    // odd multipliers of the multiply-shift hash of every row
+    constexpr std::array<uint64_t, AccessSketch::ROWS> ROW_MULTIPLIERS{
+            0x9E3779B97F4A7C15ull, 0xC2B2AE3D27D4EB4Full, 0x165667B19E3779F9ull, 0xD6E8FEB86659FD93ull};
+
+    constexpr int COLUMN_BITS = std::countr_zero(AccessSketch::COLUMNS);
+}
+
+AccessSketch::AccessSketch() : counters(std::make_unique<std::atomic<uint32_t>[]>(ROWS * COLUMNS)), samples(0),
+                               decayedTotal(0) {}
+
+/*
+ * the key is mixed once, so that the rows only need a multiplication each to pick their column
+ */
+uint32_t AccessSketch::add(Key key) {
+    uint64_t hash = mix64(static_cast<uint64_t>(key));
+
+    uint32_t estimate = std::numeric_limits<uint32_t>::max();
+    for (size_t row = 0; row < ROWS; row++) {
+        size_t column = (hash * ROW_MULTIPLIERS[row]) >> (64 - COLUMN_BITS);
+        estimate = std::min(estimate, counters[row * COLUMNS + column].fetch_add(1, std::memory_order_relaxed) + 1);
+    }
+    decayedTotal.fetch_add(1, std::memory_order_relaxed);
+    if (samples.fetch_add(1, std::memory_order_relaxed) % DECAY_SAMPLES == DECAY_SAMPLES - 1) {
+        decay();
+    }
+    return estimate;
+}
+
+uint64_t AccessSketch::total() const {
+    return decayedTotal.load(std::memory_order_relaxed);
+}
+
+void AccessSketch::decay() {
+    for (size_t i = 0; i < ROWS * COLUMNS; i++) {
+        counters[i].store(counters[i].load(std::memory_order_relaxed) / 2, std::memory_order_relaxed);
+    }
+    decayedTotal.store(decayedTotal.load(std::memory_order_relaxed) / 2, std::memory_order_relaxed);
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+#include "skip_list.hpp"
+
+/**
+ * Count-min sketch of the sampled accesses to the keys of a SkipList with TowerHeights::AccessFrequency.
+ *
+ * Every access increments one counter per row, and the estimate of a key is the smallest of its counters, which can only
+ * overestimate the true count by the accesses of colliding keys. The counters are halved every DECAY_SAMPLES samples,
+ * so the estimates follow keys that become hot or cold. Counters are updated with relaxed atomics, so concurrent
+ * increments and halving may lose a few counts, which only makes the estimates slightly less exact.
+ */
+class AccessSketch {
+public:
+    static constexpr size_t ROWS = 4;
+
+    static constexpr size_t COLUMNS = 4096;
+
+    static constexpr uint64_t DECAY_SAMPLES = COLUMNS * 8;
+
+    AccessSketch();
+
+    AccessSketch(const AccessSketch &) = delete;
+
+    AccessSketch &operator=(const AccessSketch &) = delete;
+
+    /** Counts one access to `key` and returns the estimated number of accesses to it, including this one. */
+    uint32_t add(Key key);
+
+    /** Number of counted accesses to all keys, decayed like the counters. */
+    uint64_t total() const;
+
+private:
+    // halves all counters and the total
+    void decay();
+
+    std::unique_ptr<std::atomic<uint32_t>[]> counters;
+
+    std::atomic<uint64_t> samples;
+
+    std::atomic<uint64_t> decayedTotal;
+};
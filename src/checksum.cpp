@@ -0,0 +1,68 @@
+#include "checksum.hpp"
+
+#include <array>
+#include <cstring>
+
+#if defined(__x86_64__)
+#include <nmmintrin.h>
+#endif
+
+namespace {
+    // reflected Castagnoli polynomial
+    constexpr uint32_t POLYNOMIAL = 0x82f63b78;
+
+    constexpr std::array<uint32_t, 256> makeTable() {
+        std::array<uint32_t, 256> table{};
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t crc = i;
+            for (int bit = 0; bit < 8; bit++) {
+                crc = (crc & 1) ? (crc >> 1) ^ POLYNOMIAL : crc >> 1;
+            }
+            table[i] = crc;
+        }
+        return table;
+    }
+
+    constexpr std::array<uint32_t, 256> TABLE = makeTable();
+
+    uint32_t crc32cTable(const uint8_t *data, size_t length, uint32_t crc) {
+        for (size_t i = 0; i < length; i++) {
+            crc = TABLE[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+        }
+        return crc;
+    }
+
+#if defined(__x86_64__)
+    __attribute__((target("sse4.2")))
+    uint32_t crc32cHardware(const uint8_t *data, size_t length, uint32_t crc) {
+        uint64_t crc64 = crc;
+        while (length >= sizeof(uint64_t)) {
+            uint64_t word;
+            std::memcpy(&word, data, sizeof(word));
+            crc64 = _mm_crc32_u64(crc64, word);
+            data += sizeof(word);
+            length -= sizeof(word);
+        }
+        crc = static_cast<uint32_t>(crc64);
+        while (length > 0) {
+            crc = _mm_crc32_u8(crc, *data);
+            data++;
+            length--;
+        }
+        return crc;
+    }
+
+    const bool HAS_SSE42 = __builtin_cpu_supports("sse4.2");
+#endif
+}
+
+uint32_t crc32c(const void *data, size_t length, uint32_t crc) {
+    const auto *bytes = static_cast<const uint8_t *>(data);
+    crc = ~crc;
+#if defined(__x86_64__)
+    if (HAS_SSE42) {
+        return ~crc32cHardware(bytes, length, crc);
+    }
+#endif
+    return ~crc32cTable(bytes, length, crc);
+}
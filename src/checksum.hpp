@@ -0,0 +1,11 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * CRC-32C (Castagnoli) checksum used to detect corrupted blocks in files written by the skip list.
+ * Uses the SSE 4.2 crc32 instruction if the CPU supports it and a lookup table otherwise.
+ * Pass the result of a previous call as `crc` to checksum data in several pieces.
+ */
+uint32_t crc32c(const void *data, size_t length, uint32_t crc = 0);
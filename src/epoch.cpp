@@ -0,0 +1,97 @@
+#include "epoch.hpp"
+
+#include <thread>
+
+std::atomic<uint64_t> EpochManager::globalEpoch{1};
+
+std::atomic<uint64_t> EpochManager::usedRecords{0};
+
+EpochManager::ThreadRecord EpochManager::records[EpochManager::MAX_THREADS];
+
+// releases the record of a thread when it exits
+struct EpochManager::Registration {
+    ThreadRecord *record = nullptr;
+
+    ~Registration() {
+        if (record != nullptr) {
+            record->state.store(0, std::memory_order_release);
+            record->inUse.store(false, std::memory_order_release);
+        }
+    }
+};
+
+EpochManager::ThreadRecord &EpochManager::record() {
+    static thread_local Registration registration;
+    if (registration.record != nullptr) {
+        return *registration.record;
+    }
+
+    while (true) {
+        for (uint64_t i = 0; i < MAX_THREADS; i++) {
+            bool expected = false;
+            if (!records[i].inUse.load(std::memory_order_relaxed) &&
+                records[i].inUse.compare_exchange_strong(expected, true, std::memory_order_acquire)) {
+                uint64_t used = usedRecords.load();
+                while (used < i + 1 && !usedRecords.compare_exchange_weak(used, i + 1)) {}
+                registration.record = &records[i];
+                return records[i];
+            }
+        }
+        // all records are taken -> wait for a thread to exit
+        std::this_thread::yield();
+    }
+}
+
+EpochManager::Guard::Guard() {
+    ThreadRecord &rec = record();
+    if (rec.pins++ == 0) {
+        rec.state.store((globalEpoch.load(std::memory_order_relaxed) << 1) | 1, std::memory_order_relaxed);
+        // the pin has to be visible before any shared object is read
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+    }
+}
+
+EpochManager::Guard::~Guard() {
+    ThreadRecord &rec = record();
+    if (--rec.pins == 0) {
+        rec.state.store(rec.state.load(std::memory_order_relaxed) & ~uint64_t(1), std::memory_order_release);
+    }
+}
+
+EpochManager::Guard EpochManager::pin() {
+    return {};
+}
+
+void EpochManager::retire(void *object, void (*deleter)(void *)) {
+    ThreadRecord &rec = record();
+    rec.limbo.push_back({object, deleter, globalEpoch.load()});
+    if (rec.limbo.size() % COLLECT_INTERVAL == 0) {
+        tryAdvance();
+        collect(rec);
+    }
+}
+
+void EpochManager::tryAdvance() {
+    uint64_t epoch = globalEpoch.load();
+    uint64_t used = usedRecords.load();
+    for (uint64_t i = 0; i < used; i++) {
+        uint64_t state = records[i].state.load(std::memory_order_acquire);
+        if ((state & 1) && (state >> 1) != epoch) {
+            return; // a pinned thread still runs in an older epoch
+        }
+    }
+    globalEpoch.compare_exchange_strong(epoch, epoch + 1);
+}
+
+void EpochManager::collect(ThreadRecord &record) {
+    uint64_t epoch = globalEpoch.load();
+    size_t kept = 0;
+    for (auto &retired : record.limbo) {
+        if (retired.epoch + 2 <= epoch) {
+            retired.deleter(retired.object);
+        } else {
+            record.limbo[kept++] = retired;
+        }
+    }
+    record.limbo.resize(kept);
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+/**
+ * Epoch-based reclamation for memory that lock-free readers may still access after it was unlinked.
+ *
+ * Threads pin the current epoch while they access shared objects. Unlinked objects are retired with the epoch they were
+ * retired in and freed once the global epoch advanced twice, because by then every thread that could have seen the
+ * object has unpinned. The epoch only advances if all pinned threads are in the current epoch.
+ *
+ * There is one process-wide domain. Each thread claims a record on first use and releases it on exit, a record keeps
+ * its retired objects so the next thread that claims it frees them.
+ */
+class EpochManager {
+public:
+    // RAII pin of the current epoch, pins can be nested
+    class Guard {
+    public:
+        Guard();
+
+        ~Guard();
+
+        Guard(const Guard &) = delete;
+
+        Guard &operator=(const Guard &) = delete;
+    };
+
+    /** Pins the current epoch until the returned guard is destroyed. */
+    static Guard pin();
+
+    /** Frees `object` with `deleter` once no pinned thread can access it anymore. */
+    static void retire(void *object, void (*deleter)(void *));
+
+    /** Retires an object that was allocated with new. */
+    template<typename T>
+    static void retire(T *object) {
+        retire(object, [](void *ptr) { delete static_cast<T *>(ptr); });
+    }
+
+    // maximum number of threads that can use the domain at the same time
+    static constexpr uint64_t MAX_THREADS = 1024;
+
+private:
+    struct Retired {
+        void *object;
+        void (*deleter)(void *);
+        uint64_t epoch;
+    };
+
+    struct alignas(64) ThreadRecord {
+        // (epoch << 1) | pinned
+        std::atomic<uint64_t> state{0};
+        std::atomic<bool> inUse{false};
+        // nesting depth of guards, only accessed by the owning thread
+        uint64_t pins = 0;
+        std::vector<Retired> limbo;
+    };
+
+    struct Registration;
+
+    static ThreadRecord &record();
+
+    // advances the global epoch if all pinned threads are in the current epoch
+    static void tryAdvance();
+
+    // frees the retired objects of the record that are old enough
+    static void collect(ThreadRecord &record);
+
+    // retiring this many objects triggers an attempt to advance the epoch and free objects
+    static constexpr uint64_t COLLECT_INTERVAL = 64;
+
+    static std::atomic<uint64_t> globalEpoch;
+
+    // records with an index below this have been claimed at least once
+    static std::atomic<uint64_t> usedRecords;
+
+    static ThreadRecord records[MAX_THREADS];
+};
@@ -0,0 +1,83 @@
+#include "expiry_index.hpp"
+
+#include <thread>
+
+#include "epoch.hpp"
+
+ExpiryIndex::~ExpiryIndex() {
+    // nobody uses the index anymore, so everything can be freed right away
+    for (const auto &[number, element] : buckets) {
+        auto *bucket = reinterpret_cast<Bucket *>(element);
+        Record *record = bucket->head.load();
+        while (record != nullptr && record != closed()) {
+            Record *next = record->next;
+            delete record;
+            record = next;
+        }
+        delete bucket;
+    }
+}
+
+ExpiryIndex::Record *ExpiryIndex::closed() {
+    static Record sentinel{nullptr, nullptr};
+    return &sentinel;
+}
+
+void ExpiryIndex::add(Node *node) {
+    auto guard = EpochManager::pin();
+    Key number = node->expiresAt / BUCKET_NANOSECONDS;
+    auto *record = new Record{node, nullptr};
+
+    while (true) {
+        std::optional<Element> element = buckets.find(number);
+        if (!element.has_value()) {
+            auto *bucket = new Bucket{};
+            if (!buckets.insert(number, reinterpret_cast<Element>(bucket))) {
+                delete bucket; // created concurrently, or a closed bucket was not removed yet
+            }
+            continue;
+        }
+
+        auto *bucket = reinterpret_cast<Bucket *>(*element);
+        Record *head = bucket->head.load(std::memory_order_acquire);
+        while (head != closed()) {
+            record->next = head;
+            if (bucket->head.compare_exchange_weak(head, record, std::memory_order_release,
+                                                   std::memory_order_acquire)) {
+                return;
+            }
+        }
+        // the bucket was swept after we looked it up -> wait until the sweep removed it and start a new one
+        std::this_thread::yield();
+    }
+}
+
+std::vector<Node *> ExpiryIndex::takeExpired(int64_t now) {
+    auto guard = EpochManager::pin();
+    std::vector<Node *> expired{};
+
+    // buckets that ended before now, the current bucket may still contain nodes that expire later
+    std::vector<SkipList::Entry> past{};
+    buckets.scanTo(MIN_KEY, now / BUCKET_NANOSECONDS - 1, [&](const SkipList::Entry &entry) {
+        past.push_back(entry);
+        return true;
+    });
+
+    for (const auto &[number, element] : past) {
+        auto *bucket = reinterpret_cast<Bucket *>(element);
+        Record *record = bucket->head.exchange(closed(), std::memory_order_acq_rel);
+        if (record == closed()) {
+            continue; // taken by a concurrent sweep
+        }
+        while (record != nullptr) {
+            expired.push_back(record->node);
+            Record *next = record->next;
+            delete record;
+            record = next;
+        }
+        if (buckets.remove(number).has_value()) {
+            EpochManager::retire(bucket);
+        }
+    }
+    return expired;
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+#include "skip_list.hpp"
+
+/**
+ * Index of the nodes that were inserted with a time-to-live, ordered by their deadline, so that expired entries can be
+ * removed without scanning the whole list.
+ *
+ * Nodes are grouped into buckets that cover BUCKET_NANOSECONDS of deadlines each. A bucket is a lock-free stack of
+ * nodes, and a SkipList maps the bucket number to the bucket. A sweep takes all buckets that lie completely in the
+ * past in ascending order and closes each one by swapping its stack with a sentinel, so a concurrent add() that still
+ * finds the closed bucket retries with a new one. Closed buckets are freed with epoch-based reclamation.
+ */
+class ExpiryIndex {
+public:
+    static constexpr int64_t BUCKET_NANOSECONDS = 1000000;
+
+    ExpiryIndex() = default;
+
+    ~ExpiryIndex();
+
+    ExpiryIndex(const ExpiryIndex &) = delete;
+
+    ExpiryIndex &operator=(const ExpiryIndex &) = delete;
+
+    /** Adds a root node with node->expiresAt != 0. */
+    void add(Node *node);
+
+    /**
+     * Takes all nodes whose bucket ended before `now` (nanoseconds, see SkipList::now()) out of the index and returns
+     * them in ascending bucket order. The caller has to check whether they are still in the list.
+     */
+    std::vector<Node *> takeExpired(int64_t now);
+
+private:
+    struct Record {
+        Node *node;
+        Record *next;
+    };
+
+    struct Bucket {
+        std::atomic<Record *> head{nullptr};
+    };
+
+    // head of a bucket that was taken by a sweep
+    static Record *closed();
+
+    // bucket number -> Bucket *
+    SkipList buckets;
+};
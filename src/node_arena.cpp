@@ -0,0 +1,89 @@
+#include "skip_list.hpp"
+
+#ifdef NODE_ARENA
+
+#include <algorithm>
+#include <mutex>
+#include <new>
+#include <sys/mman.h>
+
+namespace {
+    // serializes committing new pieces of the arena
+    std::mutex commitMutex;
+}
+
+// slot 0 is the null handle
+std::atomic<uint64_t> NodeArena::nextSlot{1};
+
+std::atomic<uint64_t> NodeArena::committedBytes{0};
+
+/*
+ * reserves address space for all slots without backing it by memory, aligned to huge pages
+ */
+char *NodeArena::reserve() {
+    // the last piece may be committed beyond the last slot
+    uint64_t size = MAX_NODES * sizeof(Node) + COMMIT_SIZE + HUGE_PAGE_SIZE;
+    void *memory = mmap(nullptr, size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (memory == MAP_FAILED) {
+        return nullptr;
+    }
+    auto address = reinterpret_cast<uintptr_t>(memory);
+    return reinterpret_cast<char *>((address + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1));
+}
+
+bool NodeArena::commit(uint64_t bytes) {
+    std::lock_guard<std::mutex> lock(commitMutex);
+    uint64_t committed = committedBytes.load(std::memory_order_relaxed);
+    while (committed < bytes) {
+        char *piece = base() + committed;
+        bool mapped = false;
+#ifdef NODE_HUGETLB_PAGES
+        // fails if the pool of huge pages is exhausted
+        mapped = mmap(piece, COMMIT_SIZE, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED | MAP_HUGETLB | (21 << MAP_HUGE_SHIFT), -1, 0) != MAP_FAILED;
+#endif
+        if (!mapped) {
+            // a failed MAP_FIXED may have unmapped the piece, so it is mapped again instead of only made writable
+            if (mmap(piece, COMMIT_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED | MAP_NORESERVE,
+                     -1, 0) == MAP_FAILED) {
+                return false;
+            }
+#if defined(NODE_TRANSPARENT_HUGE_PAGES) || defined(NODE_HUGETLB_PAGES)
+            madvise(piece, COMMIT_SIZE, MADV_HUGEPAGE);
+#endif
+        }
+        committed += COMMIT_SIZE;
+        committedBytes.store(committed, std::memory_order_release);
+    }
+    return true;
+}
+
+void *NodeArena::allocate() {
+    // the current batch of this thread
+    static thread_local uint64_t next = 0;
+    static thread_local uint64_t end = 0;
+
+    if (next == end) {
+        next = nextSlot.fetch_add(BATCH_SIZE, std::memory_order_relaxed);
+        end = next + BATCH_SIZE;
+        if (base() == nullptr || end > MAX_NODES) {
+            next = end;
+            throw std::bad_alloc();
+        }
+        if (end * sizeof(Node) > committedBytes.load(std::memory_order_acquire) && !commit(end * sizeof(Node))) {
+            next = end;
+            throw std::bad_alloc();
+        }
+    }
+    return base() + next++ * sizeof(Node);
+}
+
+uint64_t NodeArena::allocatedNodes() {
+    return std::min(nextSlot.load(std::memory_order_relaxed), MAX_NODES) - 1;
+}
+
+void *Node::operator new(size_t) {
+    return NodeArena::allocate();
+}
+
+#endif
@@ -0,0 +1,500 @@
+#include "persistent_skip_list.hpp"
+
+#include <fcntl.h>
+#include <random>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+    constexpr uint64_t PERSISTENT_MAGIC = 0x314c53504c4b53; // "SKLPSL1"
+
+    constexpr uint64_t PAGE_SIZE = 4096;
+
+    // enough for the header and the head and tail towers
+    constexpr uint64_t MIN_CAPACITY = 16 * PAGE_SIZE;
+
+    // same as in SkipList: the tail tower is recognized by its missing successor (offset 0), which only a non-strict
+    // search for MAX_KEY needs to check
+    template<bool Strict>
+    bool precedes(const PersistentNode *node, Key k) {
+        if constexpr (Strict) {
+            return KeyCompare::less(node->key, k);
+        } else {
+            return !KeyCompare::less(k, node->key) && (k != MAX_KEY || node->successor.load().right() != 0);
+        }
+    }
+}
+
+// first bytes of the mapping, the magic is written last so half initialized files are detected (and rejected)
+struct PersistentSkipList::Header {
+    uint64_t magic;
+    uint64_t capacity;
+    // bump allocator: offset of the first free byte
+    std::atomic<uint64_t> allocated;
+    uint64_t head;
+    uint64_t tail;
+};
+
+/*
+ * OFFSET SUCCESSOR
+ */
+OffsetSuccessor::OffsetSuccessor(uint64_t right, bool marked, bool flagged) : internal64BitData(right) {
+    if (marked) {
+        internal64BitData = internal64BitData | markedBits;
+    } else if (flagged) {
+        internal64BitData = internal64BitData | flaggedBits;
+    }
+}
+
+uint64_t OffsetSuccessor::right() const {
+    return internal64BitData & offsetMask;
+}
+
+bool OffsetSuccessor::marked() const {
+    return (internal64BitData & markedBits);
+}
+
+bool OffsetSuccessor::flagged() const {
+    return (internal64BitData & flaggedBits);
+}
+
+bool OffsetSuccessor::operator==(const OffsetSuccessor &other) const {
+    return internal64BitData == other.internal64BitData;
+}
+
+/*
+ * MAPPING
+ */
+std::unique_ptr<PersistentSkipList> PersistentSkipList::open(const std::string &path, uint64_t capacity,
+                                                             Durability durability) {
+    int fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+        return nullptr;
+    }
+
+    struct stat status{};
+    if (fstat(fd, &status) != 0) {
+        ::close(fd);
+        return nullptr;
+    }
+
+    // reuse the existing file if it contains a completely initialized skip list, never overwrite anything else
+    bool existing = status.st_size != 0;
+    if (existing) {
+        Header header{};
+        if (static_cast<uint64_t>(status.st_size) < sizeof(Header) ||
+            pread(fd, &header, sizeof(header), 0) != sizeof(header) || header.magic != PERSISTENT_MAGIC ||
+            header.capacity != static_cast<uint64_t>(status.st_size)) {
+            ::close(fd);
+            return nullptr;
+        }
+        capacity = header.capacity;
+    } else {
+        capacity = (std::max(capacity, MIN_CAPACITY) + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1);
+        if (ftruncate(fd, static_cast<off_t>(capacity)) != 0) {
+            ::close(fd);
+            return nullptr;
+        }
+    }
+
+    void *base = mmap(nullptr, capacity, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (base == MAP_FAILED) {
+        ::close(fd);
+        return nullptr;
+    }
+
+    std::unique_ptr<PersistentSkipList> list(
+            new PersistentSkipList(fd, static_cast<char *>(base), capacity, durability));
+    if (!existing) {
+        list->initialize();
+    }
+    list->head = list->node(list->header()->head);
+    list->tail = list->node(list->header()->tail);
+    return list;
+}
+
+PersistentSkipList::PersistentSkipList(int fd, char *base, uint64_t capacity, Durability durability)
+        : fd(fd), base(base), capacity(capacity), durability(durability), head(nullptr), tail(nullptr) {}
+
+PersistentSkipList::~PersistentSkipList() {
+    sync();
+    munmap(base, capacity);
+    ::close(fd);
+}
+
+void PersistentSkipList::initialize() {
+    Header *h = header();
+    h->magic = 0;
+    h->capacity = capacity;
+    h->allocated.store((sizeof(Header) + 63) & ~uint64_t(63));
+
+    PersistentNode *headNode = allocateNode(MIN_KEY, 0, 0, 0);
+    PersistentNode *tailNode = allocateNode(MAX_KEY, 0, 0, 0);
+    headNode->successor.store({offsetOf(tailNode), false, false});
+    h->head = offsetOf(headNode);
+    h->tail = offsetOf(tailNode);
+
+    // same head and tail towers as in SkipList
+    for (Level i = 0; i < MAX_LEVEL; i++) {
+        PersistentNode *upperHead = allocateNode(MIN_KEY, 0, offsetOf(headNode), h->head);
+        PersistentNode *upperTail = allocateNode(MAX_KEY, 0, offsetOf(tailNode), h->tail);
+        upperHead->successor.store({offsetOf(upperTail), false, false});
+        headNode->up = offsetOf(upperHead);
+        tailNode->up = offsetOf(upperTail);
+        headNode = upperHead;
+        tailNode = upperTail;
+    }
+
+    // the magic must only reach the file after everything else
+    msync(base, h->allocated.load(), MS_SYNC);
+    h->magic = PERSISTENT_MAGIC;
+    msync(base, PAGE_SIZE, MS_SYNC);
+}
+
+void PersistentSkipList::sync() {
+    msync(base, std::min(header()->allocated.load(), capacity), MS_SYNC);
+}
+
+void PersistentSkipList::persist(const void *address, uint64_t length) const {
+    if (durability != Durability::Strict) {
+        return;
+    }
+    auto start = reinterpret_cast<uintptr_t>(address) & ~(PAGE_SIZE - 1);
+    auto end = reinterpret_cast<uintptr_t>(address) + length;
+    msync(reinterpret_cast<void *>(start), end - start, MS_SYNC);
+}
+
+PersistentNode *PersistentSkipList::node(uint64_t offset) const {
+    return reinterpret_cast<PersistentNode *>(base + offset);
+}
+
+uint64_t PersistentSkipList::offsetOf(const PersistentNode *node) const {
+    return reinterpret_cast<const char *>(node) - base;
+}
+
+PersistentSkipList::Header *PersistentSkipList::header() const {
+    return reinterpret_cast<Header *>(base);
+}
+
+PersistentNode *PersistentSkipList::allocateNode(Key key, Element element, uint64_t down, uint64_t towerRoot) {
+    uint64_t offset = header()->allocated.fetch_add(sizeof(PersistentNode));
+    if (offset + sizeof(PersistentNode) > capacity) {
+        return nullptr; // mapping is full
+    }
+    // the allocation has to be durable before the node can be linked, otherwise it would be handed out twice
+    persist(&header()->allocated, sizeof(uint64_t));
+
+    auto *newNode = new(base + offset) PersistentNode{};
+    newNode->backLink.store(0);
+    newNode->successor.store({0, false, false});
+    newNode->down = down;
+    // root nodes reference themselves
+    newNode->towerRoot = towerRoot == 0 ? offset : towerRoot;
+    newNode->key = key;
+    newNode->element = element;
+    newNode->up = 0;
+    return newNode;
+}
+
+uint64_t PersistentSkipList::usedBytes() const {
+    return std::min(header()->allocated.load(), capacity);
+}
+
+std::vector<SkipList::Entry> PersistentSkipList::entries() const {
+    std::vector<SkipList::Entry> result;
+    PersistentNode *currNode = right(head);
+    while (currNode != tail) {
+        if (!currNode->successor.load().marked()) {
+            result.emplace_back(currNode->key, currNode->element);
+        }
+        currNode = right(currNode);
+    }
+    return result;
+}
+
+PersistentNode *PersistentSkipList::right(PersistentNode *node) const {
+    return this->node(node->successor.load().right());
+}
+
+bool PersistentSkipList::isHead(const PersistentNode *node) const {
+    return node->towerRoot == header()->head;
+}
+
+bool PersistentSkipList::isTail(const PersistentNode *node) const {
+    return node->towerRoot == header()->tail;
+}
+
+/*
+ * SKIP LIST OPERATIONS, see SkipList for a detailed description of the algorithm. Like there, MIN_KEY and MAX_KEY are
+ * valid keys of entries, and the head and tail towers are told apart by identity.
+ */
+bool PersistentSkipList::insert(Key key, Element element) {
+    std::vector<std::pair<PersistentNode *, PersistentNode *>> cache(MAX_LEVEL + 2);
+    searchToLevelAndCacheResults(key, cache);
+
+    PersistentNode *prevNode;
+    PersistentNode *nextNode;
+    std::tie(prevNode, nextNode) = cache[1];
+
+    if (!isHead(prevNode) && KeyCompare::equal(prevNode->key, key)) {
+        return false; // DUPLICATE_KEYS
+    }
+
+    PersistentNode *newRNode = allocateNode(key, element, 0, 0);
+    if (newRNode == nullptr) {
+        return false; // mapping is full
+    }
+    PersistentNode *newNode = newRNode;
+    Level towerHeight = randomTowerHeight();
+
+    Level currV = 1;
+    PersistentNode *result;
+    while (true) {
+        std::tie(prevNode, result) = insertNode(newNode, prevNode, nextNode);
+
+        if (result == nullptr && currV == 1) {
+            return false; // DUPLICATE_KEYS
+        }
+
+        if (newRNode->successor.load().marked()) {
+            if (result == newNode && newNode != newRNode) {
+                deleteNode(prevNode, newNode);
+            }
+            return true;
+        }
+
+        currV++;
+        if (currV == towerHeight + 1) {
+            return true;
+        }
+
+        PersistentNode *lastNode = newNode;
+        newNode = allocateNode(key, 0, offsetOf(lastNode), offsetOf(newRNode));
+        if (newNode == nullptr) {
+            return true; // mapping is full, keep the tower that was built so far
+        }
+
+        if (cache[currV].first == nullptr) {
+            std::tie(prevNode, nextNode) = searchToLevel(key, currV);
+        } else {
+            std::tie(prevNode, nextNode) = cache[currV];
+        }
+    }
+}
+
+std::optional<Element> PersistentSkipList::find(Key key) {
+    PersistentNode *currNode;
+    PersistentNode *nextNode;
+    std::tie(currNode, nextNode) = searchToLevel(key, 1);
+
+    if (currNode != head && KeyCompare::equal(currNode->key, key)) {
+        return currNode->element;
+    }
+    return {};
+}
+
+std::optional<Element> PersistentSkipList::remove(Key key) {
+    PersistentNode *prevNode;
+    PersistentNode *delNode;
+    std::tie(prevNode, delNode) = searchToLevel<true>(key, 1);
+
+    if (delNode == tail || !KeyCompare::equal(delNode->key, key)) {
+        return {}; // NO SUCH KEY
+    }
+
+    if (deleteNode(prevNode, delNode) == nullptr) {
+        return {}; // NO SUCH KEY
+    }
+    searchToLevel(key, 2);
+    return delNode->element;
+}
+
+template<bool Strict>
+std::pair<PersistentNode *, PersistentNode *> PersistentSkipList::searchToLevel(Key k, Level v) {
+    PersistentNode *currNode;
+    Level currV;
+
+    std::tie(currNode, currV) = findStart(v);
+    while (currV > v) {
+        currNode = node(searchRight<Strict>(k, currNode).first->down);
+        currV--;
+    }
+    return searchRight<Strict>(k, currNode);
+}
+
+void PersistentSkipList::searchToLevelAndCacheResults(
+        Key k, std::vector<std::pair<PersistentNode *, PersistentNode *>> &cache) {
+    PersistentNode *currNode = head;
+    Level currV = 1;
+
+    while (!isTail(right(currNode))) {
+        currV++;
+        currNode = node(currNode->up);
+    }
+
+    while (currV >= 1) {
+        PersistentNode *nextNode;
+        std::tie(currNode, nextNode) = searchRight(k, currNode);
+        cache[currV] = {currNode, nextNode};
+        currNode = node(currNode->down);
+        currV--;
+    }
+}
+
+std::pair<PersistentNode *, Level> PersistentSkipList::findStart(Level v) const {
+    PersistentNode *currNode = head;
+    Level currV = 1;
+
+    while (!isTail(right(node(currNode->up))) || currV < v) {
+        currNode = node(currNode->up);
+        currV++;
+    }
+    return std::make_pair(currNode, currV);
+}
+
+template<bool Strict>
+std::pair<PersistentNode *, PersistentNode *> PersistentSkipList::searchRight(Key k, PersistentNode *currNode) {
+    PersistentNode *nextNode = right(currNode);
+    bool status;
+    bool _result;
+
+    while (precedes<Strict>(nextNode, k)) {
+        // delete superfluous nodes, this also repairs deletions that were interrupted by a crash
+        while (node(nextNode->towerRoot)->successor.load().marked()) {
+            std::tie(currNode, status, _result) = tryFlagNode(currNode, nextNode);
+            if (status) {
+                helpFlagged(currNode, nextNode);
+            }
+            nextNode = right(currNode);
+        }
+
+        if (precedes<Strict>(nextNode, k)) {
+            currNode = nextNode;
+            nextNode = right(currNode);
+        }
+    }
+    return std::make_pair(currNode, nextNode);
+}
+
+std::tuple<PersistentNode *, bool, bool> PersistentSkipList::tryFlagNode(PersistentNode *prevNode,
+                                                                         PersistentNode *targetNode) {
+    uint64_t target = offsetOf(targetNode);
+    while (true) {
+        OffsetSuccessor flaggedPredecessor = {target, false, true};
+        if (prevNode->successor.load() == flaggedPredecessor) {
+            return std::make_tuple(prevNode, true, false);
+        }
+
+        OffsetSuccessor result = CAS(prevNode->successor, {target, false, false}, flaggedPredecessor);
+        if (result == flaggedPredecessor) {
+            return std::make_tuple(prevNode, true, true);
+        }
+
+        while (prevNode->successor.load().marked()) {
+            prevNode = node(prevNode->backLink.load());
+        }
+
+        PersistentNode *delNode;
+        std::tie(prevNode, delNode) = searchRight<true>(targetNode->key, prevNode);
+        if (delNode != targetNode) {
+            return std::make_tuple(prevNode, false, false);
+        }
+    }
+}
+
+std::pair<PersistentNode *, PersistentNode *> PersistentSkipList::insertNode(PersistentNode *newNode,
+                                                                             PersistentNode *prevNode,
+                                                                             PersistentNode *nextNode) {
+    if (!isHead(prevNode) && KeyCompare::equal(prevNode->key, newNode->key)) {
+        return std::make_pair(prevNode, nullptr);
+    }
+
+    uint64_t newOffset = offsetOf(newNode);
+    while (true) {
+        std::atomic<OffsetSuccessor> &prevSuccessor = prevNode->successor;
+        if (prevSuccessor.load().flagged()) {
+            helpFlagged(prevNode, node(prevSuccessor.load().right()));
+        } else {
+            newNode->successor = {offsetOf(nextNode), false, false};
+            // the node has to be complete in the file before anything points to it
+            persist(newNode, sizeof(PersistentNode));
+            OffsetSuccessor newSuccessor = {newOffset, false, false};
+            OffsetSuccessor result = CAS(prevSuccessor, {offsetOf(nextNode), false, false}, newSuccessor);
+
+            if (result == newSuccessor) {
+                return std::make_pair(prevNode, newNode);
+            }
+            if (result.flagged()) {
+                helpFlagged(prevNode, node(result.right()));
+            }
+            while (prevNode->successor.load().marked()) {
+                prevNode = node(prevNode->backLink.load());
+            }
+        }
+
+        std::tie(prevNode, nextNode) = searchRight(newNode->key, prevNode);
+        if (!isHead(prevNode) && KeyCompare::equal(prevNode->key, newNode->key)) {
+            return std::make_pair(prevNode, nullptr);
+        }
+    }
+}
+
+PersistentNode *PersistentSkipList::deleteNode(PersistentNode *prevNode, PersistentNode *delNode) {
+    bool status;
+    bool result;
+    std::tie(prevNode, status, result) = tryFlagNode(prevNode, delNode);
+
+    if (status) {
+        helpFlagged(prevNode, delNode);
+    }
+    if (!result) {
+        return nullptr; // NO SUCH NODE
+    }
+    return delNode;
+}
+
+void PersistentSkipList::helpMarked(PersistentNode *prevNode, PersistentNode *delNode) {
+    uint64_t nextOffset = delNode->successor.load().right();
+    CAS(prevNode->successor, {offsetOf(delNode), false, true}, {nextOffset, false, false});
+}
+
+void PersistentSkipList::helpFlagged(PersistentNode *prevNode, PersistentNode *delNode) {
+    delNode->backLink.store(offsetOf(prevNode));
+    // recovery after a crash relies on the back link of marked nodes
+    persist(&delNode->backLink, sizeof(uint64_t));
+    if (!delNode->successor.load().marked()) {
+        tryMark(delNode);
+    }
+    helpMarked(prevNode, delNode);
+}
+
+void PersistentSkipList::tryMark(PersistentNode *delNode) {
+    do {
+        uint64_t nextOffset = delNode->successor.load().right();
+        OffsetSuccessor result = CAS(delNode->successor, {nextOffset, false, false}, {nextOffset, true, false});
+        if (result.flagged()) {
+            helpFlagged(delNode, node(result.right()));
+        }
+    } while (!delNode->successor.load().marked());
+}
+
+OffsetSuccessor PersistentSkipList::CAS(std::atomic<OffsetSuccessor> &address, OffsetSuccessor old,
+                                        OffsetSuccessor newValue) const {
+    if (address.compare_exchange_weak(old, newValue)) {
+        persist(&address, sizeof(OffsetSuccessor));
+        return newValue;
+    }
+    return address;
+}
+
+Level PersistentSkipList::randomTowerHeight() {
+    // seeded per thread, so that threads do not draw the same heights
+    static thread_local std::mt19937 generator{std::random_device{}()};
+    std::uniform_int_distribution<int> distribution(0, 1);
+    Level towerHeight = 1;
+    while (distribution(generator) && towerHeight <= MAX_LEVEL - 1) {
+        towerHeight++;
+    }
+    return towerHeight;
+}
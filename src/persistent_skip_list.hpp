@@ -0,0 +1,185 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "skip_list.hpp"
+
+// Same as Successor, but stores the offset of the right node relative to the start of the mapping instead of a pointer.
+// Nodes are 8 byte aligned, so the lowest two bits of the offset are free for the mark and flag bits (62 bits remain).
+struct OffsetSuccessor {
+    OffsetSuccessor() = default;
+
+    OffsetSuccessor(uint64_t right, bool marked, bool flagged);
+
+    uint64_t right() const;
+
+    bool marked() const;
+
+    bool flagged() const;
+
+    bool operator==(OffsetSuccessor const &other) const;
+
+private:
+    uint64_t internal64BitData;
+
+    // x10
+    static constexpr uint64_t markedBits = uint64_t(2);
+    // x01
+    static constexpr uint64_t flaggedBits = uint64_t(1);
+
+    static constexpr uint64_t comparisonMask = uint64_t(3);
+
+    static constexpr uint64_t offsetMask = ~comparisonMask;
+};
+
+// Node of the persistent skip list, all links are offsets into the mapping (0 is the file header, i.e. no node)
+struct alignas(8) PersistentNode {
+    // offset of the previous node
+    std::atomic<uint64_t> backLink;
+    // offset of the next node (right), and if node is marked OR flagged
+    std::atomic<OffsetSuccessor> successor;
+    // offset of the node below, or 0 if root node
+    uint64_t down;
+    // offset of the root of the tower. Root nodes reference themselves.
+    uint64_t towerRoot;
+
+    Key key;
+
+    Element element;
+
+    // ONLY FOR HEAD-NODES: offset of the node above in the tower
+    uint64_t up;
+};
+
+/**
+ * Skip list that lives in a memory-mapped file, so it can be reopened after a restart without rebuilding it.
+ *
+ * It runs the same lock-free algorithm as SkipList, but nodes are allocated from the mapping with a bump allocator and
+ * all links are offsets relative to the mapping base. With Durability::Strict every node is written back before it is
+ * linked and every link update is written back before the operation continues, so the file always contains a state
+ * that the lock-free algorithm can reach and repair (e.g. half deleted nodes are cleaned up by later searches). An
+ * operation is durable once it returned. With Durability::OnSync the file is only consistent after calling sync().
+ *
+ * Space of removed nodes is not reused, and nodes allocated right before a crash may leak.
+ */
+class PersistentSkipList {
+public:
+    enum class Durability {
+        // write back every node and link update in order
+        Strict,
+        // only write back on sync() and when the list is closed
+        OnSync,
+    };
+
+    /**
+     * Opens the skip list stored in `path`, or creates a new one with a mapping of `capacity` bytes if the file does not
+     * exist or is empty. Returns nullptr if the file cannot be mapped or contains anything but a (completely initialized)
+     * skip list; such a file is left untouched.
+     */
+    static std::unique_ptr<PersistentSkipList> open(const std::string &path, uint64_t capacity,
+                                                    Durability durability = Durability::Strict);
+
+    ~PersistentSkipList();
+
+    PersistentSkipList(const PersistentSkipList &) = delete;
+
+    PersistentSkipList &operator=(const PersistentSkipList &) = delete;
+
+    /** Get the Element associated with `key`. If the key is not found, return an empty optional. */
+    std::optional<Element> find(Key key);
+
+    /**
+     * Insert the `element` associated with `key`. Return true on success, false otherwise.
+     * Inserting a duplicate key or inserting into a full mapping returns false.
+     **/
+    bool insert(Key key, Element element);
+
+    /** Remove `key` from the skip list. If it was removed, return its element, otherwise an empty optional. */
+    std::optional<Element> remove(Key key);
+
+    /** Writes the whole mapping back to the file. */
+    void sync();
+
+    /** All entries in key order. */
+    std::vector<SkipList::Entry> entries() const;
+
+    /** Bytes of the mapping that are used by nodes and the header. */
+    uint64_t usedBytes() const;
+
+private:
+    struct Header;
+
+    PersistentSkipList(int fd, char *base, uint64_t capacity, Durability durability);
+
+    // lays out the header and the head and tail towers in a fresh mapping
+    void initialize();
+
+    PersistentNode *node(uint64_t offset) const;
+
+    uint64_t offsetOf(const PersistentNode *node) const;
+
+    Header *header() const;
+
+    // allocates a node in the mapping, returns nullptr if the mapping is full
+    PersistentNode *allocateNode(Key key, Element element, uint64_t down, uint64_t towerRoot);
+
+    // writes back the pages containing [address, address + length) if durability is Strict
+    void persist(const void *address, uint64_t length) const;
+
+    // like SkipList::searchToLevel, or SkipList::searchToLevelStrict if Strict is true
+    template<bool Strict = false>
+    std::pair<PersistentNode *, PersistentNode *> searchToLevel(Key k, Level v);
+
+    // cache needs MAX_LEVEL + 2 entries, because the search starts on the lowest empty level
+    void searchToLevelAndCacheResults(Key k, std::vector<std::pair<PersistentNode *, PersistentNode *>> &cache);
+
+    std::pair<PersistentNode *, Level> findStart(Level v) const;
+
+    // like SkipList::searchRight, or SkipList::searchRightStrict if Strict is true
+    template<bool Strict = false>
+    std::pair<PersistentNode *, PersistentNode *> searchRight(Key k, PersistentNode *currNode);
+
+    std::tuple<PersistentNode *, bool, bool> tryFlagNode(PersistentNode *prevNode, PersistentNode *targetNode);
+
+    std::pair<PersistentNode *, PersistentNode *> insertNode(PersistentNode *newNode, PersistentNode *prevNode,
+                                                             PersistentNode *nextNode);
+
+    PersistentNode *deleteNode(PersistentNode *prevNode, PersistentNode *delNode);
+
+    void helpMarked(PersistentNode *prevNode, PersistentNode *delNode);
+
+    void helpFlagged(PersistentNode *prevNode, PersistentNode *delNode);
+
+    void tryMark(PersistentNode *delNode);
+
+    // CAS on a successor field, a successful update is written back before returning
+    OffsetSuccessor CAS(std::atomic<OffsetSuccessor> &address, OffsetSuccessor old, OffsetSuccessor newValue) const;
+
+    PersistentNode *right(PersistentNode *node) const;
+
+    // true for the nodes of the head tower, which have MIN_KEY like entries with the smallest key
+    bool isHead(const PersistentNode *node) const;
+
+    // true for the nodes of the tail tower, which have MAX_KEY like entries with the largest key
+    bool isTail(const PersistentNode *node) const;
+
+    Level randomTowerHeight();
+
+    int fd;
+
+    char *base;
+
+    uint64_t capacity;
+
+    Durability durability;
+
+    PersistentNode *head;
+
+    PersistentNode *tail;
+};
@@ -1,45 +1,100 @@
 #include "skip_list.hpp"
-
+#include "sorted_file.hpp"
+#include "expiry_index.hpp"
+#include "value_arena.hpp"
+#include "wide_index.hpp"
+#include "epoch.hpp"
+#include "access_sketch.hpp"
+#include "hash.hpp"
+
+#include <algorithm>
+#include <bit>
 #include <optional>
 #include <iostream>
 #include <random>
+#include <thread>
+
+namespace {
+    // true if node comes before the position that a search for k looks for. The tail tower has MAX_KEY like entries
+    // with the largest key, so it is recognized by its missing successor, but only a non-strict search for MAX_KEY
+    // needs that check: for every other k the key compare already stops at the tail.
+    template<bool Strict>
+    bool precedes(Node *node, Key k) {
+        if constexpr (Strict) {
+            return KeyCompare::less(node->key(), k);
+        } else {
+            return !KeyCompare::less(k, node->key()) && (k != MAX_KEY || node->successor.load().right() != nullptr);
+        }
+    }
+
+    std::atomic<uint64_t> nextListId{1};
+
+    // handle of one thread for one list
+    struct CachedHandle {
+        uint64_t listId = 0;
+        // calls that are using the handle, the slot is not replaced while there are any
+        size_t users = 0;
+        std::unique_ptr<SkipList::Handle> handle;
+    };
+
+    // a thread keeps the handles of the lists it used last, so that alternating between a few lists does not start a
+    // new handle on every call. Nested calls of more lists than there are slots add slots
+    constexpr size_t THREAD_HANDLES = 4;
+    thread_local std::vector<CachedHandle> threadHandles(THREAD_HANDLES);
+    thread_local size_t nextThreadHandle = 0;
+
+    // drops the cached aggregate of an index node, concurrent queries may still read it until they unpin
+    void clearAggregate(Node *node) {
+        if (SpanAggregate *cached = node->aggregate.exchange(nullptr)) {
+            EpochManager::retire(cached);
+        }
+    }
+}
 
 /*
  * NODE
  */
-Node::Node(Key key, Element element) : backLink(nullptr), down(nullptr), towerRoot(this),
-                                       entry(std::make_pair(key, element)),
-                                       up(nullptr) {}
+Node::Node(Key key, Element element) : entry(std::make_pair(key, element)), expiresAt(0), down(nullptr),
+                                       towerRoot(this), backLink(nullptr), lastAccess(0) {}
 
-Node::Node(Key key, Node *down, Node *towerRoot) : backLink(nullptr), down(down), towerRoot(towerRoot),
-                                                   entry(std::make_pair(key, 0)), up(nullptr) {}
+Node::Node(Key key, Node *down, Node *towerRoot) : entry(std::make_pair(key, 0)), aggregate(nullptr), down(down),
+                                                   towerRoot(towerRoot), backLink(nullptr), lastAccess(0) {}
 
 
 /*
 * SUCCESSOR
 */
-Successor::Successor(Node *right, bool marked, bool flagged) : internal64BitData(reinterpret_cast<uint64_t>(right)) {
+#ifdef COMPACT_NODE_REFS
+// the slot index is shifted to make room for the tag bits
+Successor::Successor(Node *right, bool marked, bool flagged) : internalData(NodeArena::index(right) << 2) {
+#else
+Successor::Successor(Node *right, bool marked, bool flagged) : internalData(reinterpret_cast<uint64_t>(right)) {
+#endif
     if (marked) {
-        internal64BitData = internal64BitData | markedBits;
+        internalData = internalData | markedBits;
     } else if (flagged) {
-        internal64BitData = internal64BitData | flaggedBits;
+        internalData = internalData | flaggedBits;
     }
 }
 
 Node *Successor::right() {
-    return reinterpret_cast<Node *>(internal64BitData & pointerMask);
+#ifdef COMPACT_NODE_REFS
+    return NodeArena::node(internalData >> 2);
+#else
+    return reinterpret_cast<Node *>(internalData & pointerMask);
+#endif
 }
 
 bool Successor::marked() const {
-    return (internal64BitData & markedBits);
+    return (internalData & markedBits);
 }
 
 bool Successor::flagged() const {
-    return (internal64BitData & flaggedBits);
+    return (internalData & flaggedBits);
 }
 
 bool Successor::operator==(const Successor &other) const {
-    return internal64BitData == other.internal64BitData;
+    return internalData == other.internalData;
 }
 
 /*
@@ -66,39 +121,318 @@ bool operator!=(const SkipList::SkipListIterator &a, const SkipList::SkipListIte
 
 bool operator==(const SkipList::SkipListIterator &a, const SkipList::SkipListIterator &b) { return a.m_ptr == b.m_ptr; }
 
+/*
+ * SKIP LIST HANDLE
+ */
+
+/*
+ * Every handle draws from its own stream, so that threads inserting in lockstep do not build towers of the same heights.
+ * The stream of a new handle starts at the position given by the seed and the number of handles created before.
+ */
+SkipList::Handle::Handle(SkipList &list) : list(list),
+                                           random{mix64(list.heightSeed ^ mix64(list.heightStreams.fetch_add(1) + 1))},
+                                           finger(nullptr), fingerGeneration(0), path(MAX_LEVEL + 2),
+                                           counters() {}
+
+uint64_t SkipList::Handle::RandomStream::operator()() {
+    state += 0x9E3779B97F4A7C15ull;
+    return mix64(state);
+}
+
+std::optional<Element> SkipList::Handle::find(Key key) {
+    // elements of variable-size values are addresses in the arena, findValue() turns them into values
+    if (list.values != nullptr) {
+        return {};
+    }
+    return list.findElement(*this, key);
+}
+
+bool SkipList::Handle::insert(Key key, Element element) {
+    KeyLockGuard lock(list.keyLock(key));
+    if (list.values != nullptr || list.insertTower(*this, key, element, 0) == nullptr) {
+        return false;
+    }
+    counters.inserts++;
+    list.evict(*this);
+    return true;
+}
+
+std::optional<Element> SkipList::Handle::remove(Key key) {
+    if (list.values != nullptr) {
+        return {};
+    }
+    return list.removeElement(*this, key);
+}
+
+const SkipList::Handle::Stats &SkipList::Handle::stats() const {
+    return counters;
+}
+
 /*
  * SKIPLIST
  */
-SkipList::SkipList() {
+SkipList::SkipList() : SkipList(SkipListOptions{}) {}
+
+SkipList::SkipList(SkipListOptions options) : options(options), entryCount(0), frozen(false), wideIndex(nullptr),
+                                              expiryIndex(nullptr), startedAggregateUpdates(0),
+                                              finishedAggregateUpdates(0), listId(nextListId.fetch_add(1)),
+                                              heightSeed(options.seed), generation(0), heightStreams(0) {
+    if (heightSeed == 0) {
+        std::random_device device;
+        heightSeed = (uint64_t(device()) << 32) | device();
+    }
+    if (options.variableSizeValues) {
+        values = std::make_unique<ValueArena>();
+    }
+    if (options.transactional) {
+        keyLocks = std::make_unique<std::atomic<uint64_t>[]>(KEY_LOCKS);
+    }
+    if (options.towerHeights == TowerHeights::AccessFrequency && !options.allowDuplicates) {
+        accessSketch = std::make_unique<AccessSketch>();
+    }
     head = new Node(MIN_KEY, 0);
     tail = new Node(MAX_KEY, 0);
 
     head->successor.store({tail, false, false});
+    headTower[0] = head;
+    tailTower[0] = tail;
 
-    Node * iteratorHead = head;
-    Node * iteratorTail = tail;
-    for (int i = 0; i < MAX_LEVEL; i++) {
-        Node * headNode = new Node(MIN_KEY, iteratorHead, head);
-        Node * tailNode = new Node(MAX_KEY, iteratorTail, tail);
+    for (int i = 1; i <= MAX_LEVEL; i++) {
+        Node * headNode = new Node(MIN_KEY, headTower[i - 1], head);
+        Node * tailNode = new Node(MAX_KEY, tailTower[i - 1], tail);
 
         headNode->successor.store({tailNode, false, false});
 
-        iteratorHead->up = headNode;
-        iteratorTail->up = tailNode;
+        // In the paper the head nodes have up pointers, the towers are kept here instead so that nodes do not need one
+        headTower[i] = headNode;
+        tailTower[i] = tailNode;
+    }
+}
 
-        iteratorHead = headNode;
-        iteratorTail = tailNode;
+SkipList::~SkipList() {
+    delete wideIndex.load();
+    delete expiryIndex.load();
+    if (options.augmented) {
+        for (Level v = 2; v <= MAX_LEVEL + 1; v++) {
+            for (Node * node = headTower[v - 1]; node != tailTower[v - 1]; node = node->successor.load().right()) {
+                delete node->aggregate.load();
+            }
+        }
     }
-    // In the paper it states that top head should reference itself with up, but is not needed
-    // iteratorHead->up = iteratorHead;
+}
+
+SkipList::Handle SkipList::handle() {
+    return Handle(*this);
 }
 
 /*
- * Insert new Node/Tower into Skip List
+ * A handle of a list that was destroyed stays in the cache until it is replaced, it is never used again because list
+ * ids are unique. Slots are replaced round-robin, skipping the ones of handles that are in use.
  */
+SkipList::ThreadHandleGuard SkipList::threadHandle() {
+    for (size_t slot = 0; slot < threadHandles.size(); slot++) {
+        if (threadHandles[slot].listId == listId) {
+            return {slot, threadHandles[slot].handle.get()};
+        }
+    }
+    size_t slot = threadHandles.size();
+    for (size_t attempt = 0; attempt < threadHandles.size() && slot == threadHandles.size(); attempt++) {
+        size_t candidate = nextThreadHandle++ % threadHandles.size();
+        if (threadHandles[candidate].users == 0) {
+            slot = candidate;
+        }
+    }
+    if (slot == threadHandles.size()) {
+        threadHandles.emplace_back();
+    }
+    threadHandles[slot] = {listId, 0, std::unique_ptr<Handle>(new Handle(*this))};
+    return {slot, threadHandles[slot].handle.get()};
+}
+
+SkipList::ThreadHandleGuard::ThreadHandleGuard(size_t slot, Handle *handle) : slot(slot), handle(handle) {
+    threadHandles[slot].users++;
+}
+
+SkipList::ThreadHandleGuard::~ThreadHandleGuard() {
+    threadHandles[slot].users--;
+}
+
 bool SkipList::insert(Key key, Element element) {
-    // search correct place to insert Node/Tower
-    std::vector<std::pair<Node *, Node *>> cache(MAX_LEVEL + 1);
+    return threadHandle()->insert(key, element);
+}
+
+bool SkipList::insert(Key key, Element element, std::chrono::nanoseconds ttl) {
+    ThreadHandleGuard handle = threadHandle();
+    KeyLockGuard lock(keyLock(key));
+    // keep 0 free for entries that never expire
+    int64_t expiresAt = std::max<int64_t>(now() + ttl.count(), 1);
+    Node * root = values == nullptr ? insertTower(*handle, key, element, expiresAt) : nullptr;
+    if (root == nullptr) {
+        return false;
+    }
+
+    ExpiryIndex * index = expiryIndex.load(std::memory_order_acquire);
+    if (index == nullptr) {
+        auto * newIndex = new ExpiryIndex();
+        if (expiryIndex.compare_exchange_strong(index, newIndex, std::memory_order_acq_rel)) {
+            index = newIndex;
+        } else {
+            delete newIndex; // created concurrently
+        }
+    }
+    index->add(root);
+    evict(*handle);
+    return true;
+}
+
+/*
+ * removes the expired nodes of the expiry index that are still in the list, like remove() does
+ * a search unlinks the expired nodes it passes, which all have smaller keys, so removing in key order leaves none of the
+ * taken nodes to other searches of this call and only removals by other threads are not counted
+ */
+size_t SkipList::removeExpired() {
+    ExpiryIndex * index = expiryIndex.load(std::memory_order_acquire);
+    if (index == nullptr || frozen.load(std::memory_order_relaxed)) {
+        return 0;
+    }
+
+    // skip the nodes that are already deleted, e.g. lazily by a search
+    std::vector<Node *> expiredNodes = index->takeExpired(now());
+    std::erase_if(expiredNodes, [](Node *node) { return node->successor.load().marked(); });
+    std::sort(expiredNodes.begin(), expiredNodes.end(),
+              [](Node *a, Node *b) { return KeyCompare::less(a->key(), b->key()); });
+
+    ThreadHandleGuard handle = threadHandle();
+    size_t removed = 0;
+    for (Node * node : expiredNodes) {
+        // the node might have been removed meanwhile, also by the search for another one
+        if (removeNode(*handle, node)) {
+            removed++;
+        }
+    }
+    return removed;
+}
+
+bool SkipList::removeNode(Handle &handle, Node *node) {
+    std::vector<std::pair<Node *, Node *>> &cache = handle.path;
+    searchToLevelStrictAndCacheResults(node->key(), cache);
+    Node * prevNode;
+    Node * delNode;
+    std::tie(prevNode, delNode) = searchRightToNode(node, cache[1].first);
+    // the key might have been reinserted as a new node
+    if (delNode != node || deleteNode(prevNode, delNode) == nullptr) {
+        return false;
+    }
+    deleteIndexNodes(node, cache);
+    return true;
+}
+
+size_t SkipList::size() const {
+    return static_cast<size_t>(std::max<int64_t>(entryCount.load(std::memory_order_relaxed), 0));
+}
+
+void SkipList::onRootDeleted(Node *node) {
+    entryCount.fetch_sub(1, std::memory_order_relaxed);
+    if (options.augmented) {
+        invalidateAggregates(node->key());
+    }
+}
+
+/*
+ * every insert evicts at most a few entries, so concurrent inserts cannot make one of them evict forever
+ */
+void SkipList::evict(Handle &handle) {
+    if (options.capacity == 0) {
+        return;
+    }
+    for (int attempt = 0; attempt < MAX_EVICTION_ATTEMPTS && size() > options.capacity; attempt++) {
+        Node * victim = evictionCandidate(handle);
+        if (victim == tail) {
+            return;
+        }
+        removeNode(handle, victim);
+    }
+}
+
+/*
+ * bulk operations add many entries at once, so unlike evict() this is not bounded to a few attempts
+ */
+void SkipList::trimToCapacity(Handle &handle) {
+    if (options.capacity == 0) {
+        return;
+    }
+    while (size() > options.capacity) {
+        Node * victim = evictionCandidate(handle);
+        if (victim == tail) {
+            return;
+        }
+        removeNode(handle, victim);
+    }
+}
+
+/*
+ * SampledLru picks random keys between the smallest and the largest key, so entries behind large gaps between keys are
+ * sampled more often, and evicts the entry with the oldest access stamp among them
+ */
+Node *SkipList::evictionCandidate(Handle &handle) {
+    Node * first = head->successor.load().right();
+    if (options.eviction == EvictionPolicy::SmallestKey || first == tail) {
+        return first;
+    }
+
+    // the samples are spread over the integers between both keys, with another KeyCompare order they are only skewed
+    Key last = searchToLevel(MAX_KEY, 1).first->key();
+    std::uniform_int_distribution<Key> distribution(first->key(), std::max(first->key(), last));
+    auto currentStamp = static_cast<uint32_t>(now() >> ACCESS_STAMP_SHIFT);
+
+    Node * candidate = first;
+    uint32_t oldestAge = 0;
+    for (int sample = 0; sample < EVICTION_SAMPLES; sample++) {
+        Node * node = lowerBound(distribution(handle.random));
+        if (node == tail) {
+            continue;
+        }
+        // the subtraction handles stamps that wrapped around
+        uint32_t age = currentStamp - node->lastAccess.load(std::memory_order_relaxed);
+        if (age >= oldestAge) {
+            candidate = node;
+            oldestAge = age;
+        }
+    }
+    return candidate;
+}
+
+void SkipList::touch(Node *node) {
+    if (options.eviction != EvictionPolicy::SampledLru || options.capacity == 0) {
+        return;
+    }
+    auto stamp = static_cast<uint32_t>(now() >> ACCESS_STAMP_SHIFT);
+    // only write if the stamp changed, so that frequent finds do not keep invalidating the cache line
+    if (node->lastAccess.load(std::memory_order_relaxed) != stamp) {
+        node->lastAccess.store(stamp, std::memory_order_relaxed);
+    }
+}
+
+int64_t SkipList::now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+bool SkipList::expired(const Node *node) {
+    return node->expiresAt != 0 && node->expiresAt <= now();
+}
+
+/*
+ * Insert new Node/Tower into Skip List
+ */
+Node *SkipList::insertTower(Handle &handle, Key key, Element element, int64_t expiresAt) {
+    if (frozen.load(std::memory_order_relaxed)) {
+        // immutable memtable -> reject cheaply before searching
+        return nullptr;
+    }
+
+    // search correct place to insert Node/Tower, indexed by level and the head tower has MAX_LEVEL + 1 levels
+    std::vector<std::pair<Node *, Node *>> &cache = handle.path;
     searchToLevelAndCacheResults(key, cache);
 
     Node * prevNode;
@@ -107,21 +441,20 @@ bool SkipList::insert(Key key, Element element) {
     // level 1 result
     std::tie(prevNode, nextNode) = cache[1];
 
-    // check if tower already exists
-    if (prevNode->key() == key) {
+    // check if tower already exists, the head has MIN_KEY as well but is no entry
+    if (prevNode != head && KeyCompare::equal(prevNode->key(), key) && !options.allowDuplicates) {
         // key is already in list -> DUPLICATE_KEYS
-        return false;
+        return nullptr;
     }
 
     // create the new root node
     Node * newRNode = new Node(key, element);
+    newRNode->expiresAt = expiresAt;
+    touch(newRNode);
     Node * newNode = newRNode; // pointer to node currently inserted into tower
 
     // determine the desired height of the tower
-    Level towerHeight = 1;
-    while (flipCoin() && towerHeight <= MAX_LEVEL - 1) {
-        towerHeight++;
-    }
+    Level towerHeight = towerHeightFor(handle, key);
 
     // the level at which newNode will be inserted
     Level currV = 1;
@@ -133,7 +466,13 @@ bool SkipList::insert(Key key, Element element) {
         // did not even insert root node
         if (result == nullptr && currV == 1) {
             // key is already in list -> DUPLICATE_KEYS
-            return false;
+            return nullptr;
+        }
+        if (currV == 1) {
+            entryCount.fetch_add(1, std::memory_order_relaxed);
+        } else if (result == nullptr) {
+            // promote() raised the tower concurrently
+            break;
         }
 
         // check if tower became superfluous
@@ -143,13 +482,13 @@ bool SkipList::insert(Key key, Element element) {
             if (result == newNode && newNode != newRNode) {
                 deleteNode(prevNode, newNode);
             }
-            return true;
+            break;
         }
 
         currV++;
         // stop building the tower -> got desired height can stop now and return successful insert
         if (currV == towerHeight + 1) {
-            return true;
+            break;
         }
 
         auto lastNode = newNode;
@@ -163,46 +502,743 @@ bool SkipList::insert(Key key, Element element) {
             std::tie(prevNode, nextNode) = cache[currV];
         }
     }
+
+    if (options.augmented) {
+        invalidateAggregates(key);
+    }
+    setFinger(handle, newRNode);
+    return newRNode;
+}
+
+std::optional<Element> SkipList::find(Key key) {
+    return threadHandle()->find(key);
+}
+
+std::optional<Element> SkipList::findElement(Handle &handle, Key key) {
+    handle.counters.finds++;
+    std::atomic<uint64_t> *lock = keyLock(key);
+    if (lock == nullptr) {
+        return lookup(handle, key);
+    }
+    uint64_t version;
+    return lookupUnlocked(handle, key, *lock, version);
 }
 
 /*
  * finds and returns the element of desired key or empty result
  */
-std::optional<Element> SkipList::find(Key key) {
+std::optional<Element> SkipList::lookup(Handle &handle, Key key) {
     Node * currNode;
     Node * nextNode;
     // find root note with firstNode <= key < secondNode
-    std::tie(currNode, nextNode) = searchToLevel(key, 1);
+    if (frozen.load(std::memory_order_acquire)) {
+        if (const WideIndex *index = wideIndex.load(std::memory_order_acquire); index != nullptr) {
+            return index->find(key);
+        }
+        std::tie(currNode, nextNode) = searchToLevelFrozen(key, 1);
+    } else {
+        std::tie(currNode, nextNode) = searchNearFinger(handle, key);
+        if (currNode != head) {
+            setFinger(handle, currNode);
+        }
+    }
 
-    if (currNode->key() == key) {
+    if (currNode != head && KeyCompare::equal(currNode->key(), key) && !expired(currNode)) {
+        touch(currNode);
+        if (accessSketch != nullptr) {
+            recordAccess(handle, currNode);
+        }
         return currNode->element();
     } else {
         return {}; // element not found
     }
 }
 
+/*
+ * The walk ahead only reads the successors, so that a key far behind the finger costs a few nodes more than a search from
+ * the top instead of a long search on level 1. The finger is a root node and is not used once its tower is deleted or
+ * expired, a search from the head unlinks it instead. Neither is it used once merge() or split_at() may have moved it
+ * to another list.
+ */
+std::pair<Node *, Node *> SkipList::searchNearFinger(Handle &handle, Key k) {
+    Node * finger = handle.finger;
+    if (finger != nullptr && handle.fingerGeneration == generation.load(std::memory_order_acquire) &&
+        precedes<false>(finger, k) && !finger->successor.load().marked() && !expired(finger)) {
+        Node * node = finger;
+        for (int distance = 0; distance < FINGER_DISTANCE; distance++) {
+            node = node->successor.load().right();
+            if (!precedes<false>(node, k)) {
+                handle.counters.fingerSearches++;
+                return searchRight(k, finger);
+            }
+        }
+    }
+    return searchToLevel(k, 1);
+}
+
+void SkipList::setFinger(Handle &handle, Node *root) const {
+    handle.finger = root;
+    handle.fingerGeneration = generation.load(std::memory_order_acquire);
+}
+
+/*
+ * A key that gets the fraction f of the sampled accesses is raised to log2(1 / f) levels below the top level, which is
+ * about where a biased skip list would put it. The target is only checked when the estimate reaches a power of two, so
+ * hot keys do not search for their tower on every sample.
+ */
+void SkipList::recordAccess(Handle &handle, Node *root) {
+    if ((handle.random() & (ACCESS_SAMPLE_RATE - 1)) != 0 || frozen.load(std::memory_order_relaxed)) {
+        return;
+    }
+    uint32_t estimate = accessSketch->add(root->key());
+    if (estimate < HOT_ACCESSES || !std::has_single_bit(estimate)) {
+        return;
+    }
+    Level top = findStart(1).second;
+    Level belowTop = std::bit_width(accessSketch->total() / estimate) - 1;
+    if (top > belowTop + 1) {
+        promote(handle, root, std::min(top - belowTop, MAX_LEVEL));
+    }
+}
+
+/*
+ * Builds on the tower like insertTower() does. A concurrent promote() of the same tower is rejected by insertNode() like
+ * a duplicate key, and nodes that were added to a tower that was deleted meanwhile are deleted again.
+ */
+void SkipList::promote(Handle &handle, Node *root, Level height) {
+    Key key = root->key();
+    std::vector<std::pair<Node *, Node *>> &cache = handle.path;
+    searchToLevelAndCacheResults(key, cache);
+    if (cache[1].first != root) {
+        return; // deleted meanwhile
+    }
+
+    // without duplicate keys, the predecessor of key on every level of the tower is the node of the tower
+    Level currV = 1;
+    Node * top = root;
+    while (currV < height && cache[currV + 1].first != nullptr && cache[currV + 1].first->towerRoot == root) {
+        currV++;
+        top = cache[currV].first;
+    }
+
+    bool raised = false;
+    for (currV++; currV <= height; currV++) {
+        Node * prevNode;
+        Node * nextNode;
+        if (cache[currV].first == nullptr) {
+            std::tie(prevNode, nextNode) = searchToLevel(key, currV);
+        } else {
+            std::tie(prevNode, nextNode) = cache[currV];
+        }
+        Node * newNode = new Node(key, top, root);
+        Node * result;
+        std::tie(prevNode, result) = insertNode(newNode, prevNode, nextNode);
+        if (result == nullptr) {
+            delete newNode; // never linked
+            break;
+        }
+        raised = true;
+        if (root->successor.load().marked()) {
+            deleteNode(prevNode, newNode);
+            break;
+        }
+        top = newNode;
+    }
+
+    if (raised && options.augmented) {
+        invalidateAggregates(key);
+    }
+}
+
+/*
+ * finds the entry with the largest key <= key
+ * an expired entry counts as absent, so the search is repeated strictly before its key, and with duplicate keys older
+ * entries of the same key that lie between the result and the expired entry are considered as well
+ */
+std::optional<std::pair<Key, Element>> SkipList::findFloor(Key key) {
+    if (values != nullptr) {
+        return {};
+    }
+    bool isFrozen = frozen.load(std::memory_order_acquire);
+    Node * currNode = isFrozen ? searchToLevelFrozen(key, 1).first : searchToLevel(key, 1).first;
+
+    while (currNode != head && expired(currNode)) {
+        Node * expiredNode = currNode;
+        currNode = isFrozen ? searchToLevelFrozen<true>(expiredNode->key(), 1).first
+                            : searchToLevelStrict(expiredNode->key(), 1).first;
+        Node * nextNode = currNode->successor.load().right();
+        while (nextNode != expiredNode && nextNode != tail && KeyCompare::equal(nextNode->key(), expiredNode->key())) {
+            if (!nextNode->successor.load().marked() && !expired(nextNode)) {
+                currNode = nextNode;
+            }
+            nextNode = nextNode->successor.load().right();
+        }
+    }
+
+    if (currNode == head) {
+        return {}; // all keys are larger
+    }
+    return currNode->entry;
+}
+
 /*
  * removes key from skip list and returns element if successful or empty result else
  */
 std::optional<Element> SkipList::remove(Key key) {
-    Node * prevNode;
-    Node * delNode;
-    std::tie(prevNode, delNode) = searchToLevel(key - 1, 1);
+    return threadHandle()->remove(key);
+}
+
+std::optional<Element> SkipList::removeElement(Handle &handle, Key key) {
+    KeyLockGuard lock(keyLock(key));
+    std::optional<Element> element = removeTower(handle, key);
+    handle.counters.removes += element.has_value();
+    return element;
+}
+
+std::optional<Element> SkipList::removeTower(Handle &handle, Key key) {
+    if (frozen.load(std::memory_order_relaxed)) {
+        return {}; // immutable memtable
+    }
+
+    // with duplicate keys, another entry of the key is removed if the oldest one is deleted concurrently or expired
+    std::vector<std::pair<Node *, Node *>> &cache = handle.path;
+    while (true) {
+        searchToLevelStrictAndCacheResults(key, cache);
+        Node * prevNode;
+        Node * delNode;
+        std::tie(prevNode, delNode) = cache[1];
+
+        // key is not found in the list
+        if (delNode == tail || !KeyCompare::equal(delNode->key(), key)) {
+            return {}; // NO SUCH KEY
+        }
+
+        // try to delete, an expired entry is deleted as well but counts as absent
+        bool wasExpired = expired(delNode);
+        Node * result = deleteNode(prevNode, delNode);
+        if (result == nullptr) {
+            // deletion was not successful
+            if (options.allowDuplicates) {
+                continue;
+            }
+            return {}; // NO SUCH KEY
+        }
+        deleteIndexNodes(delNode, cache);
+        if (prevNode != head) {
+            setFinger(handle, prevNode);
+        }
+        if (wasExpired) {
+            if (options.allowDuplicates) {
+                continue;
+            }
+            return {}; // NO SUCH KEY
+        }
+        return delNode->element();
+    }
+}
+
+size_t SkipList::removeAll(Key key) {
+    size_t removed = 0;
+    while (remove(key).has_value()) {
+        removed++;
+    }
+    return removed;
+}
+
+/*
+ * without the option, the range is scanned
+ */
+RangeAggregate SkipList::aggregate(Key lo, Key hi) {
+    RangeAggregate result{};
+    // sums of arena addresses mean nothing
+    if (KeyCompare::less(hi, lo) || values != nullptr) {
+        return result;
+    }
+    if (!options.augmented) {
+        scanTo(lo, hi, [&](const Entry &entry) {
+            result.add(entry.second);
+            return true;
+        });
+        return result;
+    }
+
+    auto guard = EpochManager::pin();
+    // the head node of the level above the topmost one that is not empty spans the whole list
+    Level v = findStart(1).second + 1;
+    return aggregateSpan(headTower[v - 1], nextLiveNode(headTower[v - 1]), v, lo, hi);
+}
+
+/*
+ * Spans that lie completely inside the range are answered from their cache, only the spans that contain one of the
+ * boundaries are split into the spans of the level below. With duplicate keys a span may contain entries with the key
+ * of endNode, so it only counts as inside the range if endNode->key() <= hi.
+ * The tower of endNode may be deleted after it was looked up, then the level below skips it and the last child would
+ * span entries behind endNode, which the caller counts with the span of endNode. So that child ends at endNode->down.
+ */
+RangeAggregate SkipList::aggregateSpan(Node *node, Node *endNode, Level v, Key lo, Key hi) {
+    RangeAggregate result{};
+    if (KeyCompare::less(hi, node->key()) || KeyCompare::less(endNode->key(), lo)) {
+        return result;
+    }
+    if (v == 1) {
+        // a root node spans only itself
+        if (node != head && !KeyCompare::less(node->key(), lo)) {
+            result.add(node->element());
+        }
+        return result;
+    }
+    if (!KeyCompare::less(node->key(), lo) && !KeyCompare::less(hi, endNode->key())) {
+        return cachedAggregate(node, endNode, v);
+    }
+
+    Node * child = node->down;
+    Node * childEnd = endNode->down;
+    // endNode->down might have been unlinked meanwhile, then the key bounds the span
+    while (child != childEnd && !KeyCompare::less(endNode->key(), child->key()) &&
+           !KeyCompare::less(hi, child->key())) {
+        Node * next = spanNext(child, endNode);
+        result.merge(aggregateSpan(child, next, v - 1, lo, hi));
+        child = next;
+    }
+    return result;
+}
+
+/*
+ * An update changes the list first and then clears the caches of the spans it changed. A cache is only kept if no
+ * update was clearing caches while it was computed: then every update that it misses clears it afterwards, and the
+ * caches of the level below that it used were not stale either. Otherwise it is only used for the current query.
+ * A query looks up the end of a span before it reads the cache, and a node may be linked or unlinked in between. So a
+ * cache is only used for the end it was computed for, otherwise the spans that a query adds up could overlap.
+ */
+RangeAggregate SkipList::cachedAggregate(Node *node, Node *endNode, Level v) {
+    SpanAggregate * cached = node->aggregate.load(std::memory_order_acquire);
+    if (cached != nullptr && cached->end == endNode) {
+        return cached->value;
+    }
+    // finished first, so equal counts mean that no update was running when started was read
+    uint64_t finished = finishedAggregateUpdates.load();
+    uint64_t started = startedAggregateUpdates.load();
+
+    RangeAggregate result{};
+    Node * child = node->down;
+    Node * childEnd = endNode->down;
+    while (child != childEnd && !KeyCompare::less(endNode->key(), child->key())) {
+        Node * next = spanNext(child, endNode);
+        if (v > 2) {
+            result.merge(cachedAggregate(child, next, v - 1));
+        } else if (child != head) {
+            result.add(child->element());
+        }
+        child = next;
+    }
 
-    // key is not found in the list
-    if (delNode->key() != key) {
-        return {}; // NO SUCH KEY
+    if (started != finished) {
+        return result;
     }
+    auto * fresh = new SpanAggregate{result, endNode};
+    // a cache for another end is replaced
+    SpanAggregate * expected = cached;
+    if (!node->aggregate.compare_exchange_strong(expected, fresh)) {
+        delete fresh; // stored or cleared concurrently
+        return result;
+    }
+    if (cached != nullptr) {
+        EpochManager::retire(cached);
+    }
+    // an update that started meanwhile might have cleared the span before the cache was stored
+    if (startedAggregateUpdates.load() != started) {
+        expected = fresh;
+        if (node->aggregate.compare_exchange_strong(expected, nullptr)) {
+            EpochManager::retire(fresh);
+        }
+    }
+    return result;
+}
 
-    // try to delete
-    Node * result = deleteNode(prevNode, delNode);
-    if (result == nullptr) {
-        // deletion was not successful
-        return {}; // NO SUCH KEY
+Node *SkipList::nextLiveNode(Node *node) {
+    Node * nextNode = node->successor.load(std::memory_order_acquire).right();
+    while (nextNode->towerRoot->successor.load(std::memory_order_acquire).marked()) {
+        nextNode = nextNode->successor.load(std::memory_order_acquire).right();
+    }
+    return nextNode;
+}
+
+Node *SkipList::spanNext(Node *child, Node *endNode) {
+    Node * nextNode = nextLiveNode(child);
+    if (nextNode != endNode->down && KeyCompare::less(endNode->key(), nextNode->key())) {
+        return endNode->down;
+    }
+    return nextNode;
+}
+
+/*
+ * Walks down like a search for key without helping other threads, so that it can be called while deleting a node.
+ * On every level the last node with a smaller key and the nodes with an equal key are cleared: the span of the first
+ * one changed if a node with key was linked or unlinked behind it. Like aggregateSpan(), the walk only stops at nodes
+ * whose tower is not deleted, because the span of such a node includes the spans of the deleted nodes behind it.
+ */
+void SkipList::invalidateAggregates(Key key) {
+    startedAggregateUpdates.fetch_add(1);
+    Node * currNode = headTower[MAX_LEVEL];
+    for (Level v = MAX_LEVEL + 1; v >= 2; v--) {
+        while (currNode->successor.load().marked()) {
+            currNode = currNode->backLink.load();
+        }
+        Node * nextNode = currNode->successor.load().right();
+        while (KeyCompare::less(nextNode->key(), key)) {
+            if (!nextNode->towerRoot->successor.load().marked()) {
+                currNode = nextNode;
+            }
+            nextNode = nextNode->successor.load().right();
+        }
+        clearAggregate(currNode);
+        while (nextNode->towerRoot != tail && KeyCompare::equal(nextNode->key(), key)) {
+            clearAggregate(nextNode);
+            nextNode = nextNode->successor.load().right();
+        }
+        currNode = currNode->down;
     }
-    // deletes the nodes at the higher levels of the tower, because search deletes superfluous nodes
-    searchToLevel(key, 2);
-    return delNode->element();
+    finishedAggregateUpdates.fetch_add(1);
+}
+
+/*
+ * Merges level by level, starting with the roots: every step links the smaller of the next nodes of both lists behind
+ * the last node of the merged level, and stores only if that changes the link, so a run of nodes from the same list
+ * is not touched. Nodes of deleted towers are left out of the merged level, which unlinks them.
+ */
+bool SkipList::merge(SkipList &&other) {
+    if (&other == this || isFrozen() || other.isFrozen() || values != nullptr || other.values != nullptr ||
+        (other.options.allowDuplicates && !options.allowDuplicates)) {
+        return false;
+    }
+    auto deleted = [](Node *node) {
+        return node->towerRoot->successor.load().marked();
+    };
+    auto link = [](Node *prevNode, Node *nextNode) {
+        if (prevNode->successor.load().right() != nextNode) {
+            prevNode->successor.store({nextNode, false, false});
+        }
+    };
+
+    std::vector<Node *> expiring{};
+    int64_t merged = 0;
+    for (Level v = 1; v <= MAX_LEVEL + 1; v++) {
+        Node * thisTail = tailTower[v - 1];
+        Node * otherTail = other.tailTower[v - 1];
+        Node * last = headTower[v - 1];
+        Node * node = last->successor.load().right();
+        Node * otherNode = other.headTower[v - 1]->successor.load().right();
+
+        while (otherNode != otherTail) {
+            Node * chosen;
+            if (deleted(otherNode)) {
+                otherNode = otherNode->successor.load().right();
+                continue;
+            }
+            if (node != thisTail && deleted(node)) {
+                node = node->successor.load().right();
+                continue;
+            }
+            if (v == 1 && !options.allowDuplicates && node != thisTail &&
+                KeyCompare::equal(node->key(), otherNode->key())) {
+                // the entry of this list is kept, marking the root drops the whole tower of the other one
+                Node * nextNode = otherNode->successor.load().right();
+                otherNode->successor.store({nextNode, true, false});
+                otherNode = nextNode;
+                continue;
+            }
+            // equal keys of this list come first, the tail comes after entries with MAX_KEY
+            if (node != thisTail && !KeyCompare::less(otherNode->key(), node->key())) {
+                chosen = node;
+                node = node->successor.load().right();
+            } else {
+                chosen = otherNode;
+                otherNode = otherNode->successor.load().right();
+                if (v == 1) {
+                    merged++;
+                    if (chosen->expiresAt != 0) {
+                        expiring.push_back(chosen);
+                    }
+                }
+            }
+            link(last, chosen);
+            last = chosen;
+        }
+        link(last, node);
+    }
+
+    // the caches of spans that now contain nodes of the other list are stale
+    if (options.augmented || other.options.augmented) {
+        for (Level v = 2; v <= MAX_LEVEL + 1; v++) {
+            for (Node * node = headTower[v - 1]; node != tailTower[v - 1]; node = node->successor.load().right()) {
+                clearAggregate(node);
+            }
+            clearAggregate(other.headTower[v - 1]);
+        }
+    }
+    for (Level v = 1; v <= MAX_LEVEL + 1; v++) {
+        other.headTower[v - 1]->successor.store({other.tailTower[v - 1], false, false});
+    }
+    other.entryCount.store(0);
+    entryCount.fetch_add(merged);
+    // fingers into other now point into this list, and fingers into this list may point to unlinked nodes of other
+    other.generation.fetch_add(1, std::memory_order_release);
+    generation.fetch_add(1, std::memory_order_release);
+
+    // the expiry index of the other list refers to nodes that are now in this list
+    delete other.expiryIndex.exchange(nullptr);
+    if (!expiring.empty()) {
+        if (expiryIndex.load() == nullptr) {
+            expiryIndex.store(new ExpiryIndex());
+        }
+        for (Node * node : expiring) {
+            expiryIndex.load()->add(node);
+        }
+    }
+    trimToCapacity(*threadHandle());
+    return true;
+}
+
+/*
+ * The new list gets the tail tower of this list, because the last node of every level of the upper part points to it,
+ * and this list gets the fresh tail tower of the new list.
+ */
+std::unique_ptr<SkipList> SkipList::split_at(Key key) {
+    if (isFrozen() || values != nullptr) {
+        return nullptr;
+    }
+    auto upper = std::make_unique<SkipList>(options);
+    // with cached aggregates the moved entries can be counted without visiting them
+    int64_t moved = options.augmented ? static_cast<int64_t>(aggregate(key, MAX_KEY).count) : 0;
+
+    // last node with a smaller key and first node with a larger or equal key of every level, skipping deleted towers
+    std::array<Node *, MAX_LEVEL + 1> lastNodes{};
+    std::array<Node *, MAX_LEVEL + 1> firstNodes{};
+    Node * currNode = headTower[MAX_LEVEL];
+    for (Level v = MAX_LEVEL + 1; v >= 1; v--) {
+        Node * nextNode = nextLiveNode(currNode);
+        while (KeyCompare::less(nextNode->key(), key)) {
+            currNode = nextNode;
+            nextNode = nextLiveNode(currNode);
+        }
+        lastNodes[v - 1] = currNode;
+        firstNodes[v - 1] = nextNode;
+        currNode = currNode->down;
+    }
+
+    std::swap(tail, upper->tail);
+    std::swap(tailTower, upper->tailTower);
+    for (Level v = 1; v <= MAX_LEVEL + 1; v++) {
+        lastNodes[v - 1]->successor.store({tailTower[v - 1], false, false});
+        upper->headTower[v - 1]->successor.store({firstNodes[v - 1], false, false});
+        if (options.augmented) {
+            clearAggregate(lastNodes[v - 1]);
+        }
+    }
+
+    if (!options.augmented) {
+        for (Node * node = firstNodes[0]; node != upper->tail; node = node->successor.load().right()) {
+            moved += !node->successor.load().marked();
+        }
+    }
+    entryCount.fetch_sub(moved);
+    upper->entryCount.store(moved);
+    // fingers at the moved entries now point into the upper list
+    generation.fetch_add(1, std::memory_order_release);
+    return upper;
+}
+
+/*
+ * stripes are chosen by a multiplicative hash, so that neighbouring keys do not share a lock
+ */
+std::atomic<uint64_t> *SkipList::keyLock(Key key) const {
+    if (keyLocks == nullptr) {
+        return nullptr;
+    }
+    uint64_t hash = static_cast<uint64_t>(key) * 0x9E3779B97F4A7C15ull;
+    return &keyLocks[hash >> (64 - std::countr_zero(KEY_LOCKS))];
+}
+
+uint64_t SkipList::lockKey(std::atomic<uint64_t> &lock) {
+    while (true) {
+        uint64_t version = lock.load(std::memory_order_relaxed);
+        if ((version & 1) == 0 && lock.compare_exchange_weak(version, version | 1, std::memory_order_acquire)) {
+            return version;
+        }
+        std::this_thread::yield();
+    }
+}
+
+/*
+ * like a sequence lock: the lookup is repeated if the lock was taken before it finished
+ */
+std::optional<Element> SkipList::lookupUnlocked(Handle &handle, Key key, std::atomic<uint64_t> &lock,
+                                                uint64_t &version) {
+    while (true) {
+        version = lock.load();
+        if ((version & 1) == 0) {
+            std::optional<Element> element = lookup(handle, key);
+            if (lock.load() == version) {
+                return element;
+            }
+        }
+        std::this_thread::yield();
+    }
+}
+
+SkipList::KeyLockGuard::KeyLockGuard(std::atomic<uint64_t> *lock) : lock(lock), version(0) {
+    if (lock != nullptr) {
+        version = lockKey(*lock);
+    }
+}
+
+SkipList::KeyLockGuard::~KeyLockGuard() {
+    if (lock != nullptr) {
+        // a new version even if nothing changed, which at worst makes a transaction retry
+        lock->store(version + 2, std::memory_order_release);
+    }
+}
+
+/*
+ * The stripes are locked in address order like in Transaction::commit(), so the two cannot deadlock. The versions do
+ * not change, because freezing does not change any entry.
+ */
+void SkipList::freeze() {
+    if (keyLocks == nullptr) {
+        frozen.store(true, std::memory_order_release);
+        return;
+    }
+    std::vector<uint64_t> versions(KEY_LOCKS);
+    for (size_t stripe = 0; stripe < KEY_LOCKS; stripe++) {
+        versions[stripe] = lockKey(keyLocks[stripe]);
+    }
+    frozen.store(true, std::memory_order_release);
+    for (size_t stripe = 0; stripe < KEY_LOCKS; stripe++) {
+        keyLocks[stripe].store(versions[stripe], std::memory_order_release);
+    }
+}
+
+/*
+ * the copy is made before inserting, so it is wasted if the key is a duplicate
+ */
+bool SkipList::insertValue(Key key, std::string_view value) {
+    if (values == nullptr || frozen.load(std::memory_order_relaxed)) {
+        return false;
+    }
+    ThreadHandleGuard handle = threadHandle();
+    KeyLockGuard lock(keyLock(key));
+    if (insertTower(*handle, key, values->store(value), 0) == nullptr) {
+        return false;
+    }
+    evict(*handle);
+    return true;
+}
+
+std::optional<std::string_view> SkipList::findValue(Key key) {
+    std::optional<Element> element = values != nullptr ? findElement(*threadHandle(), key) : std::nullopt;
+    if (!element.has_value()) {
+        return {};
+    }
+    return ValueArena::view(*element);
+}
+
+std::optional<std::string_view> SkipList::removeValue(Key key) {
+    std::optional<Element> element = values != nullptr ? removeElement(*threadHandle(), key) : std::nullopt;
+    if (!element.has_value()) {
+        return {};
+    }
+    return ValueArena::view(*element);
+}
+
+bool SkipList::isFrozen() const {
+    return frozen.load(std::memory_order_acquire);
+}
+
+/*
+ * collects the live entries in key order and publishes the index, the list is immutable so it cannot become stale
+ */
+bool SkipList::buildWideIndex() {
+    // the index does not know deadlines, so entries with a TTL would stay visible after they expired
+    if (!isFrozen() || options.allowDuplicates || expiryIndex.load(std::memory_order_acquire) != nullptr) {
+        return false;
+    }
+    if (wideIndex.load(std::memory_order_acquire) != nullptr) {
+        return true;
+    }
+
+    std::vector<Entry> entries{};
+    scanTo(MIN_KEY, MAX_KEY, [&](const Entry &entry) {
+        entries.push_back(entry);
+        return true;
+    });
+
+    auto *index = new WideIndex(entries);
+    WideIndex *expected = nullptr;
+    if (!wideIndex.compare_exchange_strong(expected, index, std::memory_order_acq_rel)) {
+        delete index; // built concurrently by another thread
+    }
+    return true;
+}
+
+/*
+ * streams the entries in key order into a sorted file, the list is immutable so no entry can appear or vanish meanwhile
+ */
+bool SkipList::flush(const std::string &path) const {
+    // a sorted file holds every key once
+    if (!isFrozen() || values != nullptr || options.allowDuplicates) {
+        return false;
+    }
+
+    SortedFileWriter writer(path);
+    Node * currNode = head->successor.load().right();
+    while (currNode != tail) {
+        // a remove might have been interrupted by freeze() -> skip logically deleted nodes, the file does not store
+        // deadlines -> skip expired entries
+        if (!currNode->successor.load().marked() && !expired(currNode) &&
+            !writer.add(currNode->key(), currNode->element())) {
+            return false;
+        }
+        currNode = currNode->successor.load().right();
+    }
+    return writer.finish();
+}
+
+size_t SkipList::scanInto(Key lo, Key hi, std::span<Entry> out) {
+    if (out.empty() || values != nullptr) {
+        return 0;
+    }
+    size_t count = 0;
+    scanTo(lo, hi, [&](const Entry &entry) {
+        out[count++] = entry;
+        return count < out.size();
+    });
+    return count;
+}
+
+size_t SkipList::scanIovec(Key lo, Key hi, std::span<iovec> out) {
+    if (out.empty() || values != nullptr) {
+        return 0;
+    }
+    size_t count = 0;
+    scanTo(lo, hi, [&](const Entry &entry) {
+        out[count++] = {const_cast<Entry *>(&entry), sizeof(Entry)};
+        return count < out.size();
+    });
+    return count;
+}
+
+std::pair<SkipList::Iterator, SkipList::Iterator> SkipList::equal_range(Key key) {
+    Node * first = lowerBound(key);
+    if (first == tail || !KeyCompare::equal(first->key(), key)) {
+        return {Iterator(first), Iterator(first)};
+    }
+    Node * last;
+    if (frozen.load(std::memory_order_acquire)) {
+        last = searchToLevelFrozen(key, 1).second;
+    } else {
+        last = searchToLevel(key, 1).second;
+    }
+    return {Iterator(first), Iterator(last)};
 }
 
 SkipList::Iterator SkipList::begin() const { return Iterator(head->successor.load().right()); }
@@ -213,6 +1249,15 @@ SkipList::Iterator SkipList::end() const { return Iterator(tail); }
  * Performs the searches in the skip list
  */
 std::pair<Node *, Node *> SkipList::searchToLevel(Key k, Level v) {
+    return searchToLevelUntil<false>(k, v);
+}
+
+std::pair<Node *, Node *> SkipList::searchToLevelStrict(Key k, Level v) {
+    return searchToLevelUntil<true>(k, v);
+}
+
+template<bool Strict>
+std::pair<Node *, Node *> SkipList::searchToLevelUntil(Key k, Level v) {
     // we declare here to unroll in while loop directly
     Node * currNode;
     Level currV;
@@ -222,45 +1267,92 @@ std::pair<Node *, Node *> SkipList::searchToLevel(Key k, Level v) {
     // searches on different levels (using the skip connections in skip list)
     while (currV > v) {
         Node * nextNode;
-        std::tie(currNode, nextNode) = searchRight(k, currNode);
+        std::tie(currNode, nextNode) = searchRightUntil<Strict>(k, currNode);
+        if constexpr (!Strict) {
+            // without duplicates, a node with key k is the predecessor on every level below, so its root is the result
+            if (v == 1 && !options.allowDuplicates && currNode->towerRoot != head &&
+                KeyCompare::equal(currNode->key(), k)) {
+                Node * root = currNode->towerRoot;
+                Successor successor = root->successor.load();
+                if (!successor.marked()) {
+                    return std::make_pair(root, successor.right());
+                }
+            }
+        }
         currNode = currNode->down;
         currV--;
     }
     // searches on level v and returns result
-    auto result = searchRight(k, currNode);
+    auto result = searchRightUntil<Strict>(k, currNode);
     return result;
 }
 
+/*
+ * Search of a frozen list, nobody modifies the list anymore so there is nothing to help with
+ */
+template<bool Strict>
+std::pair<Node *, Node *> SkipList::searchToLevelFrozen(Key k, Level v) const {
+    Node * currNode;
+    Level currV;
+
+    std::tie(currNode, currV) = findStart(v);
+    while (currV > v) {
+        currNode = searchRightFrozen<Strict>(k, currNode).first->down;
+        currV--;
+    }
+    return searchRightFrozen<Strict>(k, currNode);
+}
+
+/*
+ * Positions a range scan at its first root node
+ */
+Node *SkipList::lowerBound(Key key) {
+    // the successor of the last node with a smaller key
+    if (frozen.load(std::memory_order_acquire)) {
+        return searchToLevelFrozen<true>(key, 1).second;
+    }
+    return searchToLevelStrict(key, 1).second;
+}
+
 /*
  * Finds lowest node in head tower that points to tail tower AND is of level v or higher
  */
-std::pair<Node *, Level> SkipList::findStart(Level v) {
-    auto *currNode = head;
+std::pair<Node *, Level> SkipList::findStart(Level v) const {
     Level currV = 1;
 
-    while (currNode->up->successor.load().right()->key() != MAX_KEY || currV < v) {
-        currNode = currNode->up;
+    // the head node of level currV + 1 is headTower[currV]
+    while (headTower[currV]->successor.load().right() != tailTower[currV] || currV < v) {
         currV++;
     }
 
-    return std::make_pair(currNode, currV);
+    return std::make_pair(headTower[currV - 1], currV);
+}
+
+std::pair<Node *, Node *> SkipList::searchRight(Key k, Node *currNode) {
+    return searchRightUntil<false>(k, currNode);
+}
+
+std::pair<Node *, Node *> SkipList::searchRightStrict(Key k, Node *currNode) {
+    return searchRightUntil<true>(k, currNode);
 }
 
 /*
  * Searches Linked List on Level of currNode
  * returns currNode and nextNode with following properties
  * 1. currNode.next = nextNode
- * 2. currNode.key <= k < nextNode
+ * 2. currNode.key <= k < nextNode, or currNode.key < k <= nextNode for strict searches
  */
-std::pair<Node *, Node *> SkipList::searchRight(Key k, Node *currNode) {
+template<bool Strict>
+std::pair<Node *, Node *> SkipList::searchRightUntil(Key k, Node *currNode) {
     Node * nextNode = currNode->successor.load().right();
     bool status;
     bool _result; // don't need it
 
-    while (nextNode->key() <= k) {
+    while (precedes<Strict>(nextNode, k)) {
         // routine to delete superfluous nodes along the way when searching
         // NOTE: ADDED towerRoot pointers for tail nodes, because otherwise we get a nullptr for the tail node, which does not have a successor
-        while (nextNode->towerRoot->successor.load().marked()) {
+        // nodes of expired towers are deleted the same way, so that the search reaches and deletes the root as well
+        while (nextNode->towerRoot->successor.load().marked() || expired(nextNode->towerRoot)) {
             // flag currNode (nextNode's predecessor)
             std::tie(currNode, status, _result) = tryFlagNode(currNode, nextNode);
             // check if currNode (nextNode's predecessor) was flagged
@@ -271,7 +1363,7 @@ std::pair<Node *, Node *> SkipList::searchRight(Key k, Node *currNode) {
             nextNode = currNode->successor.load().right();
         }
 
-        if (nextNode->key() <= k) {
+        if (precedes<Strict>(nextNode, k)) {
             currNode = nextNode;
             nextNode = currNode->successor.load().right();
         }
@@ -279,6 +1371,38 @@ std::pair<Node *, Node *> SkipList::searchRight(Key k, Node *currNode) {
     return std::make_pair(currNode, nextNode);
 }
 
+/*
+ * Same properties as searchRight, but nodes of deleted towers are only skipped instead of physically deleted.
+ * Skipping still yields correct intervals because a deleted node keeps pointing to a node with a larger key.
+ */
+template<bool Strict>
+std::pair<Node *, Node *> SkipList::searchRightFrozen(Key k, Node *currNode) const {
+    Node * nextNode = currNode->successor.load(std::memory_order_acquire).right();
+
+    while (precedes<Strict>(nextNode, k)) {
+        if (!nextNode->towerRoot->successor.load(std::memory_order_acquire).marked()) {
+            currNode = nextNode;
+        }
+        nextNode = nextNode->successor.load(std::memory_order_acquire).right();
+    }
+    return std::make_pair(currNode, nextNode);
+}
+
+/*
+ * Without duplicate keys targetNode is the only node with its key, so the loop never runs
+ */
+std::pair<Node *, Node *> SkipList::searchRightToNode(Node *targetNode, Node *currNode) {
+    Node * nextNode;
+    std::tie(currNode, nextNode) = searchRightStrict(targetNode->key(), currNode);
+    // step over the older nodes with the same key, a marked one makes flagging fail and the caller searches again
+    while (nextNode != targetNode && nextNode->towerRoot != tail &&
+           KeyCompare::equal(nextNode->key(), targetNode->key())) {
+        currNode = nextNode;
+        nextNode = currNode->successor.load().right();
+    }
+    return std::make_pair(currNode, nextNode);
+}
+
 /*
  * Tries to flag predecessor of node
  * returns non-null pointer of node it tried to flag
@@ -308,7 +1432,7 @@ std::tuple<Node *, bool, bool> SkipList::tryFlagNode(Node *prevNode, Node *targe
 
         // check if we can still find target node
         Node * delNode;
-        std::tie(prevNode, delNode) = searchRight(targetNode->key() - 1, prevNode);
+        std::tie(prevNode, delNode) = searchRightToNode(targetNode, prevNode);
 
         // check if target node was deleted from the list
         if (delNode != targetNode) {
@@ -326,7 +1450,9 @@ std::tuple<Node *, bool, bool> SkipList::tryFlagNode(Node *prevNode, Node *targe
  * - second Node is either newNode (in case of successful insert) or nullptr (if failed)
  */
 std::pair<Node *, Node *> SkipList::insertNode(Node *newNode, Node *prevNode, Node *nextNode) {
-    if (prevNode->key() == newNode->key()) {
+    // nodes of the head tower have MIN_KEY as well but are no duplicates
+    if (prevNode->towerRoot != head && KeyCompare::equal(prevNode->key(), newNode->key()) &&
+        !options.allowDuplicates) {
         // DUPLICATE KEYS
         return std::make_pair(prevNode, nullptr);
     }
@@ -363,7 +1489,8 @@ std::pair<Node *, Node *> SkipList::insertNode(Node *newNode, Node *prevNode, No
         std::tie(prevNode, nextNode) = searchRight(newNode->key(), prevNode);
 
         // was already inserted
-        if (prevNode->key() == newNode->key()) {
+        if (prevNode->towerRoot != head && KeyCompare::equal(prevNode->key(), newNode->key()) &&
+            !options.allowDuplicates) {
             return std::make_pair(prevNode, nullptr);
         }
     }
@@ -399,7 +1526,13 @@ Node *SkipList::deleteNode(Node *prevNode, Node *delNode) {
  */
 void SkipList::helpMarked(Node *prevNode, Node *delNode) {
     Node * nextNode = delNode->successor.load().right();
-    CAS(prevNode->successor, {delNode, false, true}, {nextNode, false, false});
+    Successor unlinked = {nextNode, false, false};
+    Successor result = CAS(prevNode->successor, {delNode, false, true}, unlinked);
+    // unlinking an index node extends the span of its predecessor
+    if (options.augmented && delNode->down != nullptr && result == unlinked) {
+        clearAggregate(delNode);
+        invalidateAggregates(delNode->key());
+    }
 }
 
 /*
@@ -423,9 +1556,14 @@ void SkipList::helpFlagged(Node *prevNode, Node *delNode) {
 void SkipList::tryMark(Node *delNode) {
     do {
         Node * nextNode = delNode->successor.load().right();
-        Successor result = CAS(delNode->successor, {nextNode, false, false}, {nextNode, true, false});
-        // C&S can fail if either result is flagged or delNode's right pointer changed
-        if (result.flagged()) {
+        Successor result = {nextNode, false, false};
+        if (delNode->successor.compare_exchange_weak(result, {nextNode, true, false})) {
+            // only one thread can mark the node
+            if (delNode->towerRoot == delNode) {
+                onRootDeleted(delNode);
+            }
+        } else if (result.flagged()) {
+            // C&S can fail if either result is flagged or delNode's right pointer changed
             // node that should be marked is currently flagged -> try to remove flag
             helpFlagged(delNode, result.right());
         }
@@ -433,29 +1571,106 @@ void SkipList::tryMark(Node *delNode) {
 }
 
 void SkipList::print() {
-    auto headIterator = head;
-
-    while (headIterator->up != headIterator) {
+    for (Node * headIterator : headTower) {
         auto listIterator = headIterator->successor.load().right();
-        if (listIterator->key() == MAX_KEY) {
+        if (listIterator->towerRoot == tail) {
             std::cout << std::endl;
             break; // don't show empty trees
         }
         std::cout << "HEAD => ";
-        while (listIterator->key() != MAX_KEY) {
+        while (listIterator->towerRoot != tail) {
             std::cout << listIterator->key() << " => ";
             listIterator = listIterator->successor.load().right();
         }
         std::cout << "END" << std::endl;
-        headIterator = headIterator->up;
     }
     std::cout << std::endl;
 }
 
-int SkipList::flipCoin() {
-    static thread_local std::mt19937 generator;
-    std::uniform_int_distribution<int> distribution(0, 1);
-    return distribution(generator);
+/*
+ * Every bit is one coin flip with p = 0.5, so a single draw decides the whole height. Hashed heights use the splitmix64
+ * step of the key, which spreads even consecutive keys over all bits.
+ */
+Level SkipList::towerHeightFor(Handle &handle, Key key) {
+    uint64_t bits;
+    if (options.towerHeights == TowerHeights::KeyHash) {
+        bits = mix64(static_cast<uint64_t>(key) + 0x9E3779B97F4A7C15ull * (options.seed + 1));
+    } else {
+        bits = handle.random();
+    }
+    return std::min<Level>(1 + std::countr_one(bits), MAX_LEVEL);
+}
+
+size_t SkipList::searchCost(Key key) const {
+    size_t visited = 0;
+    auto [currNode, currV] = findStart(1);
+    while (true) {
+        Node * nextNode = currNode->successor.load().right();
+        visited++;
+        while (precedes<false>(nextNode, key)) {
+            currNode = nextNode;
+            nextNode = currNode->successor.load().right();
+            visited++;
+        }
+        // like searchToLevel(), stops at the first node with the key
+        if (currV == 1 ||
+            (!options.allowDuplicates && currNode->towerRoot != head && KeyCompare::equal(currNode->key(), key))) {
+            return visited;
+        }
+        currNode = currNode->down;
+        currV--;
+    }
+}
+
+std::array<size_t, MAX_LEVEL> SkipList::levelCounts() const {
+    std::array<size_t, MAX_LEVEL> counts{};
+    for (Level v = 1; v <= MAX_LEVEL; v++) {
+        Node * node = headTower[v - 1]->successor.load().right();
+        while (node != tailTower[v - 1]) {
+            counts[v - 1] += !node->towerRoot->successor.load().marked();
+            node = node->successor.load().right();
+        }
+    }
+    return counts;
+}
+
+SkipList::AppendCursor SkipList::appendCursor() const {
+    AppendCursor cursor{};
+    for (Level v = 1; v <= MAX_LEVEL + 1; v++) {
+        Node * lastNode = headTower[v - 1];
+        while (lastNode->successor.load().right() != tailTower[v - 1]) {
+            lastNode = lastNode->successor.load().right();
+        }
+        cursor.last[v - 1] = lastNode;
+        cursor.tails[v - 1] = tailTower[v - 1];
+    }
+    return cursor;
+}
+
+/*
+ * links a complete tower behind the last nodes of the cursor, which is safe because nobody else modifies the list
+ */
+void SkipList::appendTower(Handle &handle, AppendCursor &cursor, Key key, Element element) {
+    Level towerHeight = towerHeightFor(handle, key);
+
+    Node * root = new Node(key, element);
+    touch(root);
+    entryCount.fetch_add(1, std::memory_order_relaxed);
+    Node * newNode = root;
+    if (options.augmented) {
+        // the last nodes of all levels now span the new entry as well
+        for (Level v = 1; v <= MAX_LEVEL; v++) {
+            clearAggregate(cursor.last[v]);
+        }
+    }
+    for (Level v = 0; v < towerHeight; v++) {
+        if (v > 0) {
+            newNode = new Node(key, newNode, root);
+        }
+        newNode->successor.store({cursor.tails[v], false, false}, std::memory_order_relaxed);
+        cursor.last[v]->successor.store({newNode, false, false}, std::memory_order_release);
+        cursor.last[v] = newNode;
+    }
 }
 
 Successor SkipList::CAS(std::atomic<Successor> &address, Successor old, Successor newValue) const {
@@ -466,21 +1681,55 @@ Successor SkipList::CAS(std::atomic<Successor> &address, Successor old, Successo
 }
 
 void SkipList::searchToLevelAndCacheResults(Key k, std::vector<std::pair<Node *, Node *>> &cache) {
-    // we declare here to unroll in while loop directly
-    Node * currNode = head;
-    Level currV = 1;
+    searchToLevelAndCacheResultsUntil<false>(k, cache);
+}
 
-    while (currNode->successor.load().right()->key() != MAX_KEY) {
-        currV++;
-        currNode = currNode->up;
-    }
+void SkipList::searchToLevelStrictAndCacheResults(Key k, std::vector<std::pair<Node *, Node *>> &cache) {
+    searchToLevelAndCacheResultsUntil<true>(k, cache);
+}
+
+template<bool Strict>
+void SkipList::searchToLevelAndCacheResultsUntil(Key k, std::vector<std::pair<Node *, Node *>> &cache) {
+    // we declare here to unroll in while loop directly
+    Node * currNode;
+    Level currV;
+    std::tie(currNode, currV) = findStart(1);
+    // the levels above the start are not searched, the cache may still hold the results of an earlier search there
+    std::fill(cache.begin() + currV + 1, cache.end(), std::pair<Node *, Node *>(nullptr, nullptr));
 
     // searches on different levels (using the skip connections in skip list)
-    while (currV >= 1) {
+    while (currV > 1) {
         Node * nextNode;
-        std::tie(currNode, nextNode) = searchRight(k, currNode);
-        cache[currV] = {currNode, nextNode};
+        std::tie(currNode, nextNode) = searchRightUntil<Strict>(k, currNode);
+        // the compiler would store the pair through the stack and read currNode back from there, which makes the
+        // next level wait until the last node of this level has been loaded, so the fields are stored separately
+        cache[currV].first = currNode;
+        std::atomic_signal_fence(std::memory_order_seq_cst);
+        cache[currV].second = nextNode;
         currNode = currNode->down;
         currV--;
     }
+    cache[1] = searchRightUntil<Strict>(k, currNode);
+}
+
+/*
+ * The root was deleted, so the index nodes of its tower are superfluous. Instead of searching for them again, they are
+ * deleted top-down from the predecessors of the strict search that found the root: without duplicate keys, the node of
+ * the tower is the successor of the cached predecessor, with duplicate keys it is behind the older nodes with the key.
+ * deleteNode() copes with predecessors that became stale, and does nothing if a search deleted the node meanwhile.
+ */
+void SkipList::deleteIndexNodes(Node *root, const std::vector<std::pair<Node *, Node *>> &cache) {
+    for (Level v = MAX_LEVEL + 1; v >= 2; v--) {
+        auto [prevNode, towerNode] = cache[v];
+        if (prevNode == nullptr) {
+            continue; // above the levels that were searched
+        }
+        while (towerNode->towerRoot != root && towerNode->towerRoot != tail &&
+               KeyCompare::equal(towerNode->key(), root->key())) {
+            towerNode = towerNode->successor.load().right();
+        }
+        if (towerNode->towerRoot == root) {
+            deleteNode(prevNode, towerNode);
+        }
+    }
 }
@@ -1,20 +1,76 @@
+#pragma once
+
 #include <cstdint>
 #include <limits>
 #include <optional>
 #include <vector>
+#include <array>
 #include <tuple>
 #include <math.h>
+#include <algorithm>
 #include <atomic>
+#include <chrono>
 #include <ctime>
+#include <string>
+#include <string_view>
+#include <memory>
+#include <span>
+#include <sys/uio.h>
 
 using Key = int64_t;
 using Element = int64_t;
 using Level = uint64_t;
 
-// Invalid keys for head and tail towers. We will never insert a key == MIN/MAX_KEY.
+// Keys of the head and tail towers. They are valid keys of entries as well, the sentinels are told apart by identity.
 constexpr Key MIN_KEY = std::numeric_limits<Key>::min();
 constexpr Key MAX_KEY = std::numeric_limits<Key>::max();
 
+/**
+ * Order of the keys. All searches compare keys only through KeyCompare, and predecessors are found by strict searches
+ * instead of searching for key - 1, so the algorithms do not rely on integer arithmetic and a different order of the
+ * 64-bit keys needs a different less() and NATIVE_ORDER = false. The only exception are the SIMD node searches of
+ * WideIndex, which refuse to compile without the native order. MIN_KEY and MAX_KEY are the keys of the head and tail
+ * towers, so they have to stay the smallest and the largest key, but entries can have them too.
+ */
+struct KeyCompare {
+    // whether less() is the built-in order of int64_t
+    static constexpr bool NATIVE_ORDER = true;
+
+    static bool less(Key a, Key b) {
+        return a < b;
+    }
+
+    // keys are equivalent if neither is less than the other
+    static bool equal(Key a, Key b) {
+        return !less(a, b) && !less(b, a);
+    }
+};
+
+/**
+ * Normalization hook for composite keys such as (tenant, timestamp): packs two unsigned fields into a Key that is
+ * ordered like the pair, with the high field in the upper 63 - LowBits bits, so packed keys are never negative. All
+ * keys of one high field lie between pack(high, 0) and pack(high, MAX_LOW), so they can be scanned as one range.
+ */
+template<unsigned LowBits>
+struct PackedKey {
+    static_assert(LowBits > 0 && LowBits < 63, "both fields need at least one bit");
+
+    static constexpr uint64_t MAX_LOW = (uint64_t(1) << LowBits) - 1;
+    static constexpr uint64_t MAX_HIGH = (uint64_t(1) << (63 - LowBits)) - 1;
+
+    static constexpr Key pack(uint64_t high, uint64_t low) {
+        return static_cast<Key>((high << LowBits) | (low & MAX_LOW));
+    }
+
+    static constexpr uint64_t high(Key key) {
+        return static_cast<uint64_t>(key) >> LowBits;
+    }
+
+    static constexpr uint64_t low(Key key) {
+        return static_cast<uint64_t>(key) & MAX_LOW;
+    }
+};
+
 // Maximum of 8 Million keys will be inserted -> can calculate tower height
 constexpr uint64_t MAX_NUMBER_OF_KEYS = 8000000;
 // maxLevel of the tower -> log_(1/p)_(N) -> all not head or tail towers will be strictly smaller
@@ -24,9 +80,53 @@ constexpr uint64_t MAX_NUMBER_OF_KEYS = 8000000;
 // use p=0.25 -> log4(M) = 11
 constexpr uint64_t MAX_LEVEL = 22;
 
+// Nodes are allocated from the NodeArena instead of the heap if they are addressed by 32-bit handles or backed by huge
+// pages (NODE_TRANSPARENT_HUGE_PAGES: madvise, NODE_HUGETLB_PAGES: explicit hugetlbfs pages).
+#if defined(COMPACT_NODE_REFS) || defined(NODE_TRANSPARENT_HUGE_PAGES) || defined(NODE_HUGETLB_PAGES)
+#define NODE_ARENA
+#endif
+
 // forward declare
 struct Node;
 
+class WideIndex;
+
+class ExpiryIndex;
+
+class ValueArena;
+
+class Transaction;
+
+class AccessSketch;
+
+#ifdef COMPACT_NODE_REFS
+/**
+ * 32-bit handle of a node in the NodeArena, used instead of a pointer for all links between nodes when the list is built
+ * with COMPACT_NODE_REFS. Converts implicitly from and to Node *, so the algorithms are the same in both modes.
+ */
+class NodeRef {
+public:
+    NodeRef() = default;
+
+    NodeRef(Node *node);
+
+    operator Node *() const;
+
+    Node *operator->() const;
+
+private:
+    // slot in the arena, 0 is nullptr
+    uint32_t index;
+};
+
+// successor holds the slot index shifted by the two tag bits
+using SuccessorData = uint32_t;
+#else
+using NodeRef = Node *;
+
+using SuccessorData = uint64_t;
+#endif
+
 struct Successor {
     Successor() = default;
 
@@ -41,44 +141,105 @@ struct Successor {
     bool operator==(Successor const &other) const;
 
 private:
-    uint64_t internal64BitData;
+    SuccessorData internalData;
 
     // mostly copy and paste from the buffer manager assignment -> using swips, because an atomic datatype can only store 64 bits (e.g. one pointer for node)
     // so need to do pointer tagging
 
     // x10
-    static constexpr uint64_t markedBits = uint64_t(2);
+    static constexpr SuccessorData markedBits = SuccessorData(2);
     // x01
-    static constexpr uint64_t flaggedBits = uint64_t(1);
+    static constexpr SuccessorData flaggedBits = SuccessorData(1);
 
     // 3 = x11
-    static constexpr uint64_t comparisonMask = uint64_t(3);
+    static constexpr SuccessorData comparisonMask = SuccessorData(3);
 
     // we need this to get the address of our node, regardless if its marked or flagged -> so we just zero it out
-    static constexpr uint64_t pointerMask = ~comparisonMask;
+    static constexpr SuccessorData pointerMask = ~comparisonMask;
 };
 
-struct alignas(8) Node {
+// With CACHE_ALIGNED_NODES every node gets its own cache line, so CASes on the successors of neighbouring nodes do not
+// invalidate each other's lines and a search touches a single line per node. Otherwise nodes are packed tightly.
+#ifdef CACHE_ALIGNED_NODES
+constexpr size_t NODE_ALIGNMENT = 64;
+#else
+constexpr size_t NODE_ALIGNMENT = 8;
+#endif
+
+/**
+ * Count, sum, minimum and maximum of the elements of a range of entries (see SkipList::aggregate()).
+ * The sum wraps around on overflow, min and max are only meaningful if count > 0.
+ */
+struct RangeAggregate {
+    uint64_t count = 0;
+    int64_t sum = 0;
+    Element min = std::numeric_limits<Element>::max();
+    Element max = std::numeric_limits<Element>::min();
+
+    void add(Element element) {
+        count++;
+        sum = static_cast<int64_t>(static_cast<uint64_t>(sum) + static_cast<uint64_t>(element));
+        min = std::min(min, element);
+        max = std::max(max, element);
+    }
+
+    void merge(const RangeAggregate &other) {
+        count += other.count;
+        sum = static_cast<int64_t>(static_cast<uint64_t>(sum) + static_cast<uint64_t>(other.sum));
+        min = std::min(min, other.min);
+        max = std::max(max, other.max);
+    }
+};
+
+struct Node;
+
+// aggregate cached by an index node, together with the node that ended its span when it was computed
+struct SpanAggregate {
+    RangeAggregate value;
+    Node *end;
+};
+
+struct alignas(NODE_ALIGNMENT) Node {
     // constructs a root node
     Node(Key key, Element element);
 
     // one node in tower
     Node(Key key, Node *down, Node *towerRoot);
 
-    // Pointer to the previous Node
-    std::atomic<Node *> backLink;
+    // the fields read by every search step come first
+
     // Stores next node (right), and if node is marked OR flagged
     std::atomic<Successor> successor;
+
+    std::pair<Key, Element> entry;
+
+    union {
+        // ONLY FOR ROOT-NODES
+        // time in nanoseconds (see SkipList::now()) after which the entry is treated as absent, 0 if it never expires
+        int64_t expiresAt;
+        // ONLY FOR INDEX-NODES of lists with SkipListOptions::augmented
+        // aggregate of the root nodes from this node up to its successor on the same level, nullptr if it is unknown
+        std::atomic<SpanAggregate *> aggregate;
+    };
+
     // A pointer to the node below, or null if root node (lowest level)
-    Node *down;
+    NodeRef down;
     // A pointer to the root of the tower. Root Nodes will reference themselves.
-    Node *towerRoot;
+    NodeRef towerRoot;
+    // Pointer to the previous Node
+    std::atomic<NodeRef> backLink;
 
-    std::pair<Key, Element> entry;
+    // ONLY FOR ROOT-NODES with EvictionPolicy::SampledLru
+    // coarse time of the last insert or find (SkipList::now() >> ACCESS_STAMP_SHIFT, wraps around)
+    std::atomic<uint32_t> lastAccess;
 
-    // ONLY FOR HEAD-NODES
-    // A points to the node above in tower or on itself if top of tower
-    Node *up;
+#ifdef NODE_ARENA
+    // nodes live in the NodeArena, so that they can be addressed by 32-bit handles and share huge pages
+    static void *operator new(size_t size);
+
+    // arena slots are never reused, like nodes are never freed while the list exists
+    static void operator delete(void *) {}
+#endif
 
     Key key() const {
         return entry.first;
@@ -89,6 +250,113 @@ struct alignas(8) Node {
     }
 };
 
+#ifdef CACHE_ALIGNED_NODES
+static_assert(sizeof(Node) == NODE_ALIGNMENT, "a node has to fit into one cache line");
+#endif
+
+#ifdef NODE_ARENA
+/**
+ * Process-wide arena of node slots. The address space for MAX_NODES slots is reserved up front, so a slot index can be
+ * turned into an address with one multiply-add, and it is committed in pieces of COMMIT_SIZE bytes as slots are taken.
+ * With huge pages, the committed pieces are backed by 2MB pages, so a lookup that touches nodes all over the list needs
+ * far fewer TLB entries. If no hugetlbfs pages are left, the arena falls back to transparent huge pages.
+ * Threads take slots in batches to avoid contention on the allocation counter. Slots are never reused.
+ */
+class NodeArena {
+public:
+    // the successor needs two of the 32 bits as tag bits
+    static constexpr uint64_t MAX_NODES = uint64_t(1) << 30;
+
+    static constexpr uint64_t HUGE_PAGE_SIZE = uint64_t(2) << 20;
+
+    // returns the address of a new slot, throws std::bad_alloc if all slots are taken or memory cannot be committed
+    static void *allocate();
+
+    static Node *node(uint32_t index) {
+        return index == 0 ? nullptr : reinterpret_cast<Node *>(base() + uint64_t(index) * sizeof(Node));
+    }
+
+    static uint32_t index(const Node *node) {
+        return node == nullptr ? 0 : static_cast<uint32_t>((reinterpret_cast<const char *>(node) - base()) / sizeof(Node));
+    }
+
+    // number of slots taken by threads so far, including the unused rest of their batches
+    static uint64_t allocatedNodes();
+
+private:
+    // slots that a thread takes at once
+    static constexpr uint64_t BATCH_SIZE = 256;
+
+    static constexpr uint64_t COMMIT_SIZE = 32 * HUGE_PAGE_SIZE;
+
+    static char *reserve();
+
+    // makes sure that the first `bytes` bytes of the arena are usable
+    static bool commit(uint64_t bytes);
+
+    // reserved on first use, so lists in static storage of other translation units can allocate nodes during their
+    // own initialization
+    static char *base() {
+        static char *const reserved = reserve();
+        return reserved;
+    }
+
+    static std::atomic<uint64_t> nextSlot;
+
+    static std::atomic<uint64_t> committedBytes;
+};
+#endif
+
+#ifdef COMPACT_NODE_REFS
+inline NodeRef::NodeRef(Node *node) : index(NodeArena::index(node)) {}
+
+inline NodeRef::operator Node *() const {
+    return NodeArena::node(index);
+}
+
+inline Node *NodeRef::operator->() const {
+    return NodeArena::node(index);
+}
+#endif
+
+
+enum class EvictionPolicy {
+    // evict the entry with the smallest key
+    SmallestKey,
+    // evict the least recently used of a few randomly sampled entries, using access stamps in the nodes
+    SampledLru,
+};
+
+enum class TowerHeights {
+    // drawn from the random stream of the inserting thread
+    Random,
+    // derived from a hash of the key and SkipListOptions::seed, so a key always gets the same height and lists with the
+    // same entries have the same shape, no matter in which order or by which path (insert, load, merge) they were built
+    KeyHash,
+    // random, but find() samples the accesses to the keys in an AccessSketch and raises the towers of hot keys, so that
+    // they are found in fewer steps. Towers are never lowered again. Not supported with duplicate keys
+    AccessFrequency,
+};
+
+struct SkipListOptions {
+    // maximum number of entries, 0 means unbounded. Bounds the entries, not the memory (see SkipList(SkipListOptions))
+    size_t capacity = 0;
+    // how entries are evicted when an insert exceeds the capacity
+    EvictionPolicy eviction = EvictionPolicy::SmallestKey;
+    // multimap mode: entries with equal keys are kept in insertion order instead of rejecting duplicates
+    bool allowDuplicates = false;
+    // entries hold byte strings of any length (insertValue/findValue) instead of Elements
+    bool variableSizeValues = false;
+    // index nodes cache aggregates of the entries they skip, so that aggregate() does not visit every entry
+    bool augmented = false;
+    // single-key operations synchronize with Transactions on versioned locks of key stripes
+    bool transactional = false;
+    // how the height of a new tower is chosen
+    TowerHeights towerHeights = TowerHeights::Random;
+    // seed of the tower heights, 0 draws one per list for random heights. With a fixed seed, the n-th Handle of the list
+    // draws the same heights in every run, e.g. for reproducible benchmarks
+    uint64_t seed = 0;
+};
 
 /**
  * Main skip list class as described my Mikhail Fomitchev and Eric Ruppert in "Lock-Free Linked Lists and Skip Lists",
@@ -103,25 +371,249 @@ struct alignas(8) Node {
  *  - Section 4.4.2 contains a few optimization hints, which are useful for the optimized baseline.
  */
 class SkipList {
+    friend class Transaction;
+
 public:
     /** Construct the SkipList with all the members that you need. */
     SkipList();
 
-    /** Get the Element associated with `key`. If the key is not found, return an empty optional. */
+    /**
+     * Construct a SkipList that is bounded to `options.capacity` entries: an insert that exceeds the capacity evicts
+     * entries according to `options.eviction`, so the list can be used as a cache without a separate LRU structure.
+     * Under concurrent inserts the size may exceed the capacity by up to the number of inserting threads. merge() and
+     * load() evict as well once all entries were added.
+     * The capacity bounds the number of entries, not the memory of the list: like removed ones, evicted towers (and their
+     * variable-size values) are unlinked but only freed with the list, because iterators, scans and findValue() hand out
+     * references that stay valid as long as the list exists. Memory grows with the number of inserts, so a long-running
+     * cache has to be replaced by a fresh list from time to time.
+     */
+    explicit SkipList(SkipListOptions options);
+
+    ~SkipList();
+
+    SkipList(const SkipList &) = delete;
+
+    SkipList &operator=(const SkipList &) = delete;
+
+    /**
+     * Get the Element associated with `key`. If the key is not found, return an empty optional.
+     * With SkipListOptions::transactional, a find that overlaps with a commit of a Transaction that writes a key of
+     * the same stripe is repeated, so it never sees a part of the transaction.
+     */
     std::optional<Element> find(Key key);
 
+    /**
+     * Get the entry with the largest key <= `key`, skipping expired entries. If there is no such entry, return an empty
+     * optional.
+     */
+    std::optional<std::pair<Key, Element>> findFloor(Key key);
+
     /**
      * Insert the `element` associated with `key`. Return true on success, false otherwise.
      * Inserting a duplicate key returns false.
      **/
     bool insert(Key key, Element element);
 
+    /**
+     * Insert like insert(), but the entry expires `ttl` from now. Expired entries are treated as absent by find() and
+     * remove(), searches that pass them unlink them lazily, and removeExpired() removes them by deadline.
+     * Iterators and scans may still return expired entries that were not unlinked yet.
+     */
+    bool insert(Key key, Element element, std::chrono::nanoseconds ttl);
+
+    /**
+     * Removes the entries whose deadline passed at least ExpiryIndex::BUCKET_NANOSECONDS ago, found by their deadlines
+     * (rounded to buckets) without scanning the list. Meant to be called periodically by a sweeper thread.
+     * Returns the number of entries that this call removed, entries unlinked by other operations meanwhile are not
+     * counted.
+     */
+    size_t removeExpired();
+
+    /** Current time in nanoseconds as used for expiry deadlines (steady clock). */
+    static int64_t now();
+
+    /** Number of entries. Updated with the insert or removal of a root node, so it is exact once the list is quiescent. */
+    size_t size() const;
+
     /**
      * Remove the `element` and `key` from the skip list. If the `element` was removed, return it. Otherwise, return an
      * empty optional to indicate that the key was not removed.
+     * With duplicate keys, the oldest entry of the key is removed, and find() returns the newest one.
      */
     std::optional<Element> remove(Key key);
 
+    /** Removes all entries of `key` and returns how many were removed. */
+    size_t removeAll(Key key);
+
+    /**
+     * Per-thread state of the operations on the list: the random stream for tower heights and eviction samples, a finger
+     * at the root node of the last accessed key, the search results of the last insert or remove, and counters.
+     * Calling find(), insert() and remove() through a handle spares looking up this state on every call, and a find()
+     * of a key a few entries behind the finger walks there instead of descending from the top level. The calls of the
+     * list without a handle use a handle that the list keeps for every thread.
+     *
+     * A handle is used by one thread at a time and must not outlive its list.
+     */
+    class alignas(64) Handle {
+    public:
+        struct Stats {
+            uint64_t finds = 0;
+            // finds that searched from the finger
+            uint64_t fingerSearches = 0;
+            // successful inserts and removes
+            uint64_t inserts = 0;
+            uint64_t removes = 0;
+        };
+
+        Handle(const Handle &) = delete;
+
+        Handle(Handle &&) = default;
+
+        Handle &operator=(const Handle &) = delete;
+
+        /** Same as SkipList::find(). */
+        std::optional<Element> find(Key key);
+
+        /** Same as SkipList::insert(). */
+        bool insert(Key key, Element element);
+
+        /** Same as SkipList::remove(). */
+        std::optional<Element> remove(Key key);
+
+        /** Operations through this handle. */
+        const Stats &stats() const;
+
+    private:
+        friend class SkipList;
+
+        explicit Handle(SkipList &list);
+
+        // splitmix64 stream, usable with the distributions of <random>
+        struct RandomStream {
+            using result_type = uint64_t;
+
+            static constexpr uint64_t min() { return 0; }
+
+            static constexpr uint64_t max() { return std::numeric_limits<uint64_t>::max(); }
+
+            uint64_t operator()();
+
+            uint64_t state;
+        };
+
+        SkipList &list;
+
+        RandomStream random;
+
+        // root node of the last key that was found, inserted or preceded a removed one, nullptr at first
+        Node *finger;
+
+        // SkipList::generation when the finger was set, the finger is not used once it changed
+        uint64_t fingerGeneration;
+
+        // results of the last cached search on every level, kept so that inserts and removes do not allocate them
+        std::vector<std::pair<Node *, Node *>> path;
+
+        Stats counters;
+    };
+
+    /** A new Handle for the calling thread. Every handle draws the tower heights from a stream of its own. */
+    Handle handle();
+
+    /**
+     * With SkipListOptions::variableSizeValues: inserts a copy of `value` that is stored in an arena of the list, so
+     * no separate lifetime management is needed. Returns false for a duplicate key or if the list does not store
+     * variable-size values. In this mode, the elements of the entries are addresses in the arena, so the other insert
+     * functions as well as find(), findFloor(), remove(), scanInto(), scanIovec() and aggregate() are rejected like
+     * for a missing key or an empty range. Iterators and scanTo() still hand out the addresses, ValueArena::view() turns
+     * them into values.
+     * Copies are only freed with the list, also the ones of removed or evicted entries, so the arena grows with every
+     * insert (see ValueArena).
+     */
+    bool insertValue(Key key, std::string_view value);
+
+    /** Get the value inserted with insertValue(). The view stays valid as long as the list exists. */
+    std::optional<std::string_view> findValue(Key key);
+
+    /** Remove an entry that was inserted with insertValue(). The returned view stays valid as long as the list exists. */
+    std::optional<std::string_view> removeValue(Key key);
+
+    /**
+     * Count, sum, min and max of the elements of all entries with lo <= key <= hi.
+     * With SkipListOptions::augmented, every index node caches the aggregate of the entries up to its successor, so a
+     * query only descends along the two boundaries of the range and takes O(log n) steps once the caches are filled.
+     * Updates invalidate the caches on their search path and the next query recomputes them. A query that runs
+     * concurrently with updates may or may not include them, and a cache is not kept if the list changed while it was
+     * computed, so results are exact once the list is quiescent. Expired entries count until they are unlinked.
+     * Without the option, the entries of the range are scanned.
+     */
+    RangeAggregate aggregate(Key lo, Key hi);
+
+    /**
+     * Moves all entries of `other` into this list and leaves `other` empty. The nodes of `other` are reused: every level
+     * is merged in a single pass over both lists, so runs of keys of `other` are spliced in without searching for every
+     * key. Without duplicate keys, entries of `other` whose key is already in this list are dropped. Towers keep their
+     * heights, so merging lists with TowerHeights::KeyHash and the same seed gives the shape of a list built directly.
+     * Requires that nobody else uses either list until it returns. Returns false if one of the lists is frozen or stores
+     * variable-size values, or if `other` allows duplicate keys and this list does not.
+     */
+    bool merge(SkipList &&other);
+
+    /**
+     * Moves the entries with keys >= `key` into a new list with the same options and returns it. One search finds the
+     * last node before `key` on every level, those nodes are linked to a new tail tower and the old tail tower is
+     * handed to the new list, so the links inside both parts are not touched. Keeping size() exact needs one pass over
+     * the moved entries, unless the list is SkipListOptions::augmented. Expired entries that were moved are only
+     * unlinked lazily, not by removeExpired(). Requires that nobody else uses the list until it returns. Returns nullptr
+     * if the list is frozen or stores variable-size values.
+     */
+    std::unique_ptr<SkipList> split_at(Key key);
+
+    /**
+     * Makes the skip list immutable, e.g. once it is full and should be used as an immutable memtable.
+     * Further inserts and removes are rejected and lookups switch to a traversal that does not help other threads.
+     * Operations that were already running when freeze() was called may still finish, so callers have to let them
+     * drain before flushing. With SkipListOptions::transactional, freeze() takes the locks of all key stripes, so it
+     * waits for running commits of Transactions and later commits fail.
+     */
+    void freeze();
+
+    bool isFrozen() const;
+
+    /**
+     * Builds a WideIndex over the entries of a frozen list, so that find() searches several keys per cache line
+     * instead of following one node per key. Like flush(), this has to wait until operations that were running during
+     * freeze() have finished. Returns false if the list is not frozen, allows duplicate keys or ever held entries with
+     * a TTL, building the index twice has no effect.
+     */
+    bool buildWideIndex();
+
+    /**
+     * Writes all entries of a frozen skip list in key order to a block-based sorted file at `path` (see SortedFile).
+     * The file has no deadlines, so entries that expired are left out and the others never expire once read back.
+     * Returns false if the list is not frozen, allows duplicate keys, stores variable-size values or the file could not
+     * be written.
+     */
+    bool flush(const std::string &path) const;
+
+    /**
+     * Writes a binary snapshot of all entries to `path`: keys are delta encoded and stored in checksummed blocks.
+     * Like flush(), the snapshot has no deadlines, entries that expired are left out.
+     * Concurrent modifications are allowed, but then it is undefined whether they are part of the snapshot.
+     * Returns false if the list stores variable-size values or the file could not be written.
+     */
+    bool save(const std::string &path) const;
+
+    /**
+     * Rebuilds the skip list from a snapshot written by save(). The list has to be empty and must not be used by
+     * other threads until load() returns, because towers are appended directly instead of being inserted.
+     * Returns false if the list is not empty, stores variable-size values or the file is missing or corrupt, or if the
+     * snapshot contains duplicate keys and the list does not allow them.
+     * A corrupt block stops loading, so the
+     * list then only contains the entries of the blocks before it.
+     */
+    bool load(const std::string &path);
+
     // DO NOT CHANGE THESE.
     // These types are needed for the iterator interface.
     using Entry = std::pair<Key, Element>;
@@ -155,26 +647,253 @@ public:
 
     using Iterator = SkipListIterator;
 
+    /**
+     * Copies the entries with lo <= key <= hi in key order directly into `out` and returns how many were written.
+     * Stops when `out` is full, the next chunk of the range starts behind the key of the last written entry.
+     */
+    size_t scanInto(Key lo, Key hi, std::span<Entry> out);
+
+    /**
+     * Calls `writer(entry)` with a reference to every entry with lo <= key <= hi in key order, without copying them.
+     * The references stay valid as long as the skip list exists. Stops early if the writer returns false.
+     * Returns the number of entries that were passed to the writer.
+     */
+    template<typename Writer>
+    size_t scanTo(Key lo, Key hi, Writer &&writer);
+
+    /**
+     * Points the iovecs in `out` to the entries with lo <= key <= hi (one iovec of sizeof(Entry) bytes per entry), so a
+     * range can be handed to writev or io_uring without copying it first. Returns how many iovecs were filled.
+     */
+    size_t scanIovec(Key lo, Key hi, std::span<iovec> out);
+
+    /**
+     * Iterators to the first entry with `key` and to the first entry behind them, like std::multimap::equal_range().
+     * With duplicate keys, the entries of the key are in insertion order.
+     */
+    std::pair<Iterator, Iterator> equal_range(Key key);
+
     /// Begin and end iterators for the skip list to allow iterating over all entries.
     Iterator begin() const;
 
     Iterator end() const;
 
+    /**
+     * Number of nodes of live towers on every level, index 0 is level 1. Diagnostic for the distribution of the tower
+     * heights; nodes that are inserted or deleted concurrently may or may not be counted.
+     */
+    std::array<size_t, MAX_LEVEL> levelCounts() const;
+
+    /**
+     * Number of nodes that a search for `key` visits on all levels, without helping other threads. Diagnostic for the
+     * shape of the list, e.g. to compare tower height policies.
+     */
+    size_t searchCost(Key key) const;
+
     void print();
 
 private:
     // starts from the head tower and searches for two consecutive nodes on level v, such that the first has a key less than or euqal to k, and the second has a key stricly greater than k
     std::pair<Node *, Node *> searchToLevel(Key k, Level v);
 
+    // same as searchToLevel, but the first node has a key strictly less than k and the second a key greater or equal
+    std::pair<Node *, Node *> searchToLevelStrict(Key k, Level v);
+
+    // searchToLevel, or searchToLevelStrict if Strict is true
+    template<bool Strict>
+    std::pair<Node *, Node *> searchToLevelUntil(Key k, Level v);
+
+    // same as searchToLevel (or searchToLevelStrict), but for frozen lists: does not help deleting nodes and only skips them
+    template<bool Strict = false>
+    std::pair<Node *, Node *> searchToLevelFrozen(Key k, Level v) const;
+
+    // same as searchRight (or searchRightStrict), but for frozen lists: does not help deleting nodes and only skips them
+    template<bool Strict = false>
+    std::pair<Node *, Node *> searchRightFrozen(Key k, Node *currNode) const;
+
+    // rightmost node and tail node on every level, used to append sorted input without searching
+    struct AppendCursor {
+        std::array<Node *, MAX_LEVEL + 1> last;
+        std::array<Node *, MAX_LEVEL + 1> tails;
+    };
+
+    // creates a cursor that points to the end of every level (requires that nobody modifies the list)
+    AppendCursor appendCursor() const;
+
+    // appends a new tower behind the cursor, key has to be larger than all keys in the list (requires quiescence)
+    void appendTower(Handle &handle, AppendCursor &cursor, Key key, Element element);
+
+    // keeps the handle of the calling thread for a list in use: the thread does not give the cache slot of the handle to
+    // another list while the guard exists, so nested calls of other lists (e.g. of the list of an ExpiryIndex) cannot
+    // destroy it
+    class ThreadHandleGuard {
+    public:
+        ThreadHandleGuard(size_t slot, Handle *handle);
+
+        ~ThreadHandleGuard();
+
+        ThreadHandleGuard(const ThreadHandleGuard &) = delete;
+
+        ThreadHandleGuard &operator=(const ThreadHandleGuard &) = delete;
+
+        Handle &operator*() const {
+            return *handle;
+        }
+
+        Handle *operator->() const {
+            return handle;
+        }
+
+    private:
+        size_t slot;
+        Handle *handle;
+    };
+
+    // handle of the calling thread for this list, used by the calls without a handle
+    ThreadHandleGuard threadHandle();
+
+    // Handle::find() and Handle::remove() without rejecting variable-size values, for findValue() and removeValue()
+    std::optional<Element> findElement(Handle &handle, Key key);
+
+    std::optional<Element> removeElement(Handle &handle, Key key);
+
+    // inserts a new tower and returns its root node, or nullptr for a duplicate key
+    Node *insertTower(Handle &handle, Key key, Element element, int64_t expiresAt);
+
+    // find() without synchronizing with transactions
+    std::optional<Element> lookup(Handle &handle, Key key);
+
+    // searchToLevel(k, 1), but starts from the finger of the handle if k is at most FINGER_DISTANCE nodes behind it
+    std::pair<Node *, Node *> searchNearFinger(Handle &handle, Key k);
+
+    // points the finger of the handle to the root node
+    void setFinger(Handle &handle, Node *root) const;
+
+    // remove() without synchronizing with transactions
+    std::optional<Element> removeTower(Handle &handle, Key key);
+
+    // samples an access to root with TowerHeights::AccessFrequency and raises its tower if the key is hot
+    void recordAccess(Handle &handle, Node *root);
+
+    // adds index nodes on top of the tower of root until it reaches height
+    void promote(Handle &handle, Node *root, Level height);
+
+    // lock of the stripe of key with SkipListOptions::transactional, nullptr otherwise
+    std::atomic<uint64_t> *keyLock(Key key) const;
+
+    // waits until the lock is free, locks it and returns its version
+    static uint64_t lockKey(std::atomic<uint64_t> &lock);
+
+    // lookup() while the lock is free, version is the version of the lock during the lookup
+    std::optional<Element> lookupUnlocked(Handle &handle, Key key, std::atomic<uint64_t> &lock, uint64_t &version);
+
+    // holds the lock of a stripe for one single-key update, does nothing if the list is not transactional
+    class KeyLockGuard {
+    public:
+        explicit KeyLockGuard(std::atomic<uint64_t> *lock);
+
+        ~KeyLockGuard();
+
+        KeyLockGuard(const KeyLockGuard &) = delete;
+
+        KeyLockGuard &operator=(const KeyLockGuard &) = delete;
+
+    private:
+        std::atomic<uint64_t> *lock;
+        uint64_t version;
+    };
+
+    // number of key stripes, a power of two
+    static constexpr size_t KEY_LOCKS = 4096;
+
+    // one in ACCESS_SAMPLE_RATE finds is counted in the AccessSketch, a power of two
+    static constexpr uint64_t ACCESS_SAMPLE_RATE = 8;
+
+    // estimated samples of a key before its tower is raised
+    static constexpr uint32_t HOT_ACCESSES = 16;
+
+    // a find() searches from the finger if its key is at most this many root nodes behind it
+    static constexpr int FINGER_DISTANCE = 8;
+
+    // true if the deadline of the root node has passed
+    static bool expired(const Node *node);
+
+    // deletes the tower of the root node if it is still in the list, returns true if this call deleted it
+    bool removeNode(Handle &handle, Node *node);
+
+    // same as searchRightStrict(targetNode->key(), currNode), but with duplicate keys it continues over the nodes with
+    // the same key until the second node is targetNode or has a larger key
+    std::pair<Node *, Node *> searchRightToNode(Node *targetNode, Node *currNode);
+
+    // called exactly once for every root node, by the thread that marked it
+    void onRootDeleted(Node *node);
+
+    // evicts entries until the size is within the capacity
+    void evict(Handle &handle);
+
+    // same as evict, but for merge() and load(), which run alone and may exceed the capacity by many entries
+    void trimToCapacity(Handle &handle);
+
+    // aggregate of the root nodes with lo <= key <= hi in the span of node on level v, which ends before endNode
+    RangeAggregate aggregateSpan(Node *node, Node *endNode, Level v, Key lo, Key hi);
+
+    // cached aggregate of the whole span of the index node up to endNode, computed from the spans of the level below if
+    // unknown or cached for another end
+    RangeAggregate cachedAggregate(Node *node, Node *endNode, Level v);
+
+    // next node on the level of node whose tower is not deleted
+    static Node *nextLiveNode(Node *node);
+
+    // end of the span of child, a node one level below endNode, that does not reach behind endNode
+    static Node *spanNext(Node *child, Node *endNode);
+
+    // clears the cached aggregates of the spans that contain key or end at it, called after key was inserted or deleted
+    void invalidateAggregates(Key key);
+
+    // root node that should be evicted next according to the eviction policy, or the tail if the list is empty
+    Node *evictionCandidate(Handle &handle);
+
+    // updates the access stamp of a root node for EvictionPolicy::SampledLru
+    void touch(Node *node);
+
+    // the access stamp counts in units of 2^20 ns (about 1 ms)
+    static constexpr int ACCESS_STAMP_SHIFT = 20;
+
+    // number of entries compared by EvictionPolicy::SampledLru
+    static constexpr int EVICTION_SAMPLES = 5;
+
+    // an insert stops evicting after this many attempts, e.g. because concurrent inserts keep the list full
+    static constexpr int MAX_EVICTION_ATTEMPTS = 8;
+
+    // first root node with a key >= key, or the tail
+    Node *lowerBound(Key key);
+
     // caches all the search results on every level
     void searchToLevelAndCacheResults(Key k, std::vector<std::pair<Node *, Node *>> &cache);
 
+    // same as searchToLevelAndCacheResults, but with the results of strict searches
+    void searchToLevelStrictAndCacheResults(Key k, std::vector<std::pair<Node *, Node *>> &cache);
+
+    // searchToLevelAndCacheResults, or searchToLevelStrictAndCacheResults if Strict is true
+    template<bool Strict>
+    void searchToLevelAndCacheResultsUntil(Key k, std::vector<std::pair<Node *, Node *>> &cache);
+
+    // deletes the index nodes of the tower of the deleted root, using the results of the search that found root
+    void deleteIndexNodes(Node *root, const std::vector<std::pair<Node *, Node *>> &cache);
+
     // Searches the head tower for the lowest node that points to the tail tower
-    std::pair<Node *, Level> findStart(Level v);
+    std::pair<Node *, Level> findStart(Level v) const;
 
     // starts from currentNode and searches the level for two consecutive nodes such that the first has a key less or equal to k, and the second has a key strictly greater than k
     std::pair<Node *, Node *> searchRight(Key k, Node *currNode);
 
+    // same as searchRight, but the first node has a key strictly less than k and the second a key greater or equal to k
+    std::pair<Node *, Node *> searchRightStrict(Key k, Node *currNode);
+
+    // searchRight, or searchRightStrict if Strict is true
+    template<bool Strict>
+    std::pair<Node *, Node *> searchRightUntil(Key k, Node *currNode);
+
     // attempts to flag the predecessor of targetNode
     std::tuple<Node *, bool, bool> tryFlagNode(Node *prevNode, Node *targetNode);
 
@@ -195,9 +914,73 @@ private:
 
     Successor CAS(std::atomic<Successor> &address, Successor old, Successor newValue) const;
 
-    int flipCoin();
+    // height of a new tower for key, i.e. the number of nodes including the root node
+    Level towerHeightFor(Handle &handle, Key key);
 
     Node *head;
 
     Node *tail;
+
+    // head and tail node of every level, index 0 is level 1
+    std::array<Node *, MAX_LEVEL + 1> headTower;
+
+    std::array<Node *, MAX_LEVEL + 1> tailTower;
+
+    SkipListOptions options;
+
+    // number of root nodes in the list
+    std::atomic<int64_t> entryCount;
+
+    // set by freeze(), the list does not accept any more modifications
+    std::atomic<bool> frozen;
+
+    // built by buildWideIndex() and used by find() on frozen lists
+    std::atomic<WideIndex *> wideIndex;
+
+    // created by the first insert with a ttl
+    std::atomic<ExpiryIndex *> expiryIndex;
+
+    // copies of the values with SkipListOptions::variableSizeValues
+    std::unique_ptr<ValueArena> values;
+
+    // invalidateAggregates() calls that started and finished, a cache is only kept if no call ran during its computation
+    std::atomic<uint64_t> startedAggregateUpdates;
+
+    std::atomic<uint64_t> finishedAggregateUpdates;
+
+    // versioned locks of the key stripes with SkipListOptions::transactional: version << 1 | locked
+    std::unique_ptr<std::atomic<uint64_t>[]> keyLocks;
+
+    // unique per list, so that threads can tell their handles of different lists apart
+    uint64_t listId;
+
+    // SkipListOptions::seed or a random one
+    uint64_t heightSeed;
+
+    // changed by merge() and split_at(), which move nodes to other lists, so that handles drop fingers into them
+    std::atomic<uint64_t> generation;
+
+    // number of handles of this list, the random stream of every handle starts from a different position
+    std::atomic<uint64_t> heightStreams;
+
+    // sampled accesses with TowerHeights::AccessFrequency
+    std::unique_ptr<AccessSketch> accessSketch;
 };
+
+template<typename Writer>
+size_t SkipList::scanTo(Key lo, Key hi, Writer &&writer) {
+    size_t count = 0;
+    Node * currNode = lowerBound(lo);
+    while (currNode != tail && !KeyCompare::less(hi, currNode->key())) {
+        Successor successor = currNode->successor.load();
+        // skip logically deleted nodes
+        if (!successor.marked()) {
+            count++;
+            if (!writer(static_cast<const Entry &>(currNode->entry))) {
+                break;
+            }
+        }
+        currNode = successor.right();
+    }
+    return count;
+}
@@ -0,0 +1,177 @@
+#include "skip_list.hpp"
+#include "checksum.hpp"
+
+#include <fstream>
+
+/*
+ * SNAPSHOT FORMAT
+ *
+ * header: magic (8 bytes)
+ * blocks: entry count (4 bytes), payload size (4 bytes), crc32c of the payload (4 bytes), payload
+ * end:    block with an entry count of 0
+ *
+ * The payload stores the entries as varints. The first key of a block is stored zigzag encoded, every following key as
+ * the (always positive) difference to its predecessor. Elements are stored zigzag encoded.
+ */
+namespace {
+    constexpr uint64_t SNAPSHOT_MAGIC = 0x31504e534c4b53; // "SKLSNP1"
+
+    // entries are encoded in blocks of this size, so a block and its checksum stay in cache
+    constexpr uint32_t ENTRIES_PER_BLOCK = 4096;
+
+    // largest encoding of a key and an element
+    constexpr uint32_t MAX_ENTRY_SIZE = 20;
+
+    struct BlockHeader {
+        uint32_t entryCount;
+        uint32_t payloadSize;
+        uint32_t checksum;
+    };
+
+    uint64_t zigzag(int64_t value) {
+        return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+    }
+
+    int64_t unzigzag(uint64_t value) {
+        return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+    }
+
+    void putVarint(std::vector<uint8_t> &buffer, uint64_t value) {
+        while (value >= 0x80) {
+            buffer.push_back(static_cast<uint8_t>(value | 0x80));
+            value >>= 7;
+        }
+        buffer.push_back(static_cast<uint8_t>(value));
+    }
+
+    // returns false if the varint does not end before `end`
+    bool getVarint(const uint8_t *&pos, const uint8_t *end, uint64_t &value) {
+        value = 0;
+        for (int shift = 0; shift < 64 && pos < end; shift += 7) {
+            uint8_t byte = *pos++;
+            value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+            if ((byte & 0x80) == 0) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool writeBlock(std::ofstream &file, uint32_t entryCount, const std::vector<uint8_t> &payload) {
+        BlockHeader header{entryCount, static_cast<uint32_t>(payload.size()),
+                           crc32c(payload.data(), payload.size())};
+        file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        file.write(reinterpret_cast<const char *>(payload.data()), static_cast<std::streamsize>(payload.size()));
+        return file.good();
+    }
+}
+
+bool SkipList::save(const std::string &path) const {
+    if (values != nullptr) {
+        return false; // elements are addresses in the value arena
+    }
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file.write(reinterpret_cast<const char *>(&SNAPSHOT_MAGIC), sizeof(SNAPSHOT_MAGIC));
+
+    std::vector<uint8_t> payload;
+    payload.reserve(ENTRIES_PER_BLOCK * MAX_ENTRY_SIZE);
+    uint32_t entryCount = 0;
+    Key prevKey = 0;
+
+    Node * currNode = head->successor.load().right();
+    while (currNode != tail) {
+        // skip logically deleted nodes and expired entries, the snapshot does not store deadlines
+        if (!currNode->successor.load().marked() && !expired(currNode)) {
+            if (entryCount == 0) {
+                putVarint(payload, zigzag(currNode->key()));
+            } else {
+                putVarint(payload, static_cast<uint64_t>(currNode->key()) - static_cast<uint64_t>(prevKey));
+            }
+            putVarint(payload, zigzag(currNode->element()));
+            prevKey = currNode->key();
+
+            if (++entryCount == ENTRIES_PER_BLOCK) {
+                if (!writeBlock(file, entryCount, payload)) {
+                    return false;
+                }
+                payload.clear();
+                entryCount = 0;
+            }
+        }
+        currNode = currNode->successor.load().right();
+    }
+
+    if (entryCount > 0 && !writeBlock(file, entryCount, payload)) {
+        return false;
+    }
+    payload.clear();
+    if (!writeBlock(file, 0, payload)) {
+        return false;
+    }
+    file.flush();
+    return file.good();
+}
+
+bool SkipList::load(const std::string &path) {
+    if (head->successor.load().right() != tail || values != nullptr) {
+        return false; // bulk construction only works on an empty list
+    }
+
+    std::ifstream file(path, std::ios::binary);
+    uint64_t magic = 0;
+    file.read(reinterpret_cast<char *>(&magic), sizeof(magic));
+    if (!file || magic != SNAPSHOT_MAGIC) {
+        return false;
+    }
+
+    AppendCursor cursor = appendCursor();
+    ThreadHandleGuard handle = threadHandle();
+    std::vector<uint8_t> payload;
+    bool first = true;
+    Key prevKey = 0;
+
+    // appending needs the cursor, so the capacity is only enforced once all readable blocks are in the list
+    auto appendBlocks = [&] {
+        while (true) {
+            BlockHeader header{};
+            file.read(reinterpret_cast<char *>(&header), sizeof(header));
+            if (!file || header.payloadSize > ENTRIES_PER_BLOCK * MAX_ENTRY_SIZE) {
+                return false;
+            }
+            if (header.entryCount == 0) {
+                return true; // end of the snapshot
+            }
+
+            payload.resize(header.payloadSize);
+            file.read(reinterpret_cast<char *>(payload.data()), header.payloadSize);
+            if (!file || crc32c(payload.data(), payload.size()) != header.checksum) {
+                return false;
+            }
+
+            const uint8_t *pos = payload.data();
+            const uint8_t *end = pos + payload.size();
+            for (uint32_t i = 0; i < header.entryCount; i++) {
+                uint64_t encodedKey;
+                uint64_t encodedElement;
+                if (!getVarint(pos, end, encodedKey) || !getVarint(pos, end, encodedElement)) {
+                    return false;
+                }
+
+                Key key = i == 0 ? unzigzag(encodedKey) : static_cast<Key>(static_cast<uint64_t>(prevKey) + encodedKey);
+                // keys have to be ascending (strictly, unless duplicates are allowed), otherwise appending would
+                // corrupt the list
+                if (!first && (KeyCompare::less(key, prevKey) ||
+                               (!options.allowDuplicates && KeyCompare::equal(key, prevKey)))) {
+                    return false;
+                }
+                appendTower(*handle, cursor, key, unzigzag(encodedElement));
+                prevKey = key;
+                first = false;
+            }
+        }
+    };
+
+    bool complete = appendBlocks();
+    trimToCapacity(*handle);
+    return complete;
+}
@@ -0,0 +1,108 @@
+#include "sorted_file.hpp"
+
+#include <algorithm>
+
+/*
+ * WRITER
+ */
+SortedFileWriter::SortedFileWriter(const std::string &path) : file(path, std::ios::binary | std::ios::trunc),
+                                                               offset(0), entryCount(0) {
+    block.reserve(SortedFile::ENTRIES_PER_BLOCK);
+}
+
+bool SortedFileWriter::add(Key key, Element element) {
+    if (!block.empty() && !KeyCompare::less(block.back().first, key)) {
+        return false; // keys have to be strictly ascending
+    }
+    if (block.empty() && !index.empty() && !KeyCompare::less(index.back().lastKey, key)) {
+        return false;
+    }
+
+    block.emplace_back(key, element);
+    entryCount++;
+    if (block.size() == SortedFile::ENTRIES_PER_BLOCK) {
+        return flushBlock();
+    }
+    return true;
+}
+
+bool SortedFileWriter::finish() {
+    if (!block.empty() && !flushBlock()) {
+        return false;
+    }
+
+    SortedFile::Footer footer{offset, index.size(), entryCount, SortedFile::MAGIC};
+    file.write(reinterpret_cast<const char *>(index.data()),
+               static_cast<std::streamsize>(index.size() * sizeof(SortedFile::BlockHandle)));
+    file.write(reinterpret_cast<const char *>(&footer), sizeof(footer));
+    file.flush();
+    return file.good();
+}
+
+bool SortedFileWriter::flushBlock() {
+    uint64_t bytes = block.size() * sizeof(std::pair<Key, Element>);
+    index.push_back({block.front().first, block.back().first, offset, block.size()});
+
+    file.write(reinterpret_cast<const char *>(block.data()), static_cast<std::streamsize>(bytes));
+    offset += bytes;
+    block.clear();
+    return file.good();
+}
+
+/*
+ * READER
+ */
+bool SortedFileReader::open(const std::string &path) {
+    file.open(path, std::ios::binary);
+    if (!file) {
+        return false;
+    }
+
+    SortedFile::Footer footer{};
+    file.seekg(-static_cast<std::streamoff>(sizeof(footer)), std::ios::end);
+    file.read(reinterpret_cast<char *>(&footer), sizeof(footer));
+    if (!file || footer.magic != SortedFile::MAGIC) {
+        return false;
+    }
+
+    index.resize(footer.blockCount);
+    file.seekg(static_cast<std::streamoff>(footer.indexOffset));
+    file.read(reinterpret_cast<char *>(index.data()),
+              static_cast<std::streamsize>(index.size() * sizeof(SortedFile::BlockHandle)));
+    entryCount = footer.entryCount;
+    block.reserve(SortedFile::ENTRIES_PER_BLOCK);
+    return file.good();
+}
+
+std::optional<Element> SortedFileReader::find(Key key) {
+    // first block whose last key is not smaller than key -> only candidate that can contain key
+    auto handle = std::lower_bound(index.begin(), index.end(), key,
+                                   [](const SortedFile::BlockHandle &h, Key k) { return KeyCompare::less(h.lastKey, k); });
+    if (handle == index.end() || KeyCompare::less(key, handle->firstKey)) {
+        return {};
+    }
+
+    block.resize(handle->count);
+    file.seekg(static_cast<std::streamoff>(handle->offset));
+    file.read(reinterpret_cast<char *>(block.data()),
+              static_cast<std::streamsize>(block.size() * sizeof(std::pair<Key, Element>)));
+    if (!file) {
+        file.clear();
+        return {};
+    }
+
+    auto entry = std::lower_bound(block.begin(), block.end(), key,
+                                  [](const std::pair<Key, Element> &e, Key k) { return KeyCompare::less(e.first, k); });
+    if (entry == block.end() || !KeyCompare::equal(entry->first, key)) {
+        return {};
+    }
+    return entry->second;
+}
+
+uint64_t SortedFileReader::size() const {
+    return entryCount;
+}
+
+uint64_t SortedFileReader::blockCount() const {
+    return index.size();
+}
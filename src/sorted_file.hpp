@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "skip_list.hpp"
+
+/**
+ * Block-based sorted file that a frozen SkipList (memtable) is flushed to.
+ *
+ * Layout:
+ *  - data blocks: up to ENTRIES_PER_BLOCK raw (key, element) pairs in ascending key order
+ *  - index: one BlockHandle per data block
+ *  - footer: position of the index, number of blocks and entries, and a magic number
+ *
+ * Lookups binary search the index, which is kept in memory, and then read and search a single block.
+ */
+namespace SortedFile {
+    // 256 entries of 16 bytes -> 4 KiB blocks
+    constexpr uint64_t ENTRIES_PER_BLOCK = 256;
+
+    constexpr uint64_t MAGIC = 0x534b4c5353544231; // "SKLSSTB1"
+
+    struct BlockHandle {
+        Key firstKey;
+        Key lastKey;
+        uint64_t offset;
+        uint64_t count;
+    };
+
+    struct Footer {
+        uint64_t indexOffset;
+        uint64_t blockCount;
+        uint64_t entryCount;
+        uint64_t magic;
+    };
+}
+
+class SortedFileWriter {
+public:
+    explicit SortedFileWriter(const std::string &path);
+
+    /** Appends an entry, keys have to be strictly ascending. Returns false on a write error or unordered key. */
+    bool add(Key key, Element element);
+
+    /** Writes the last block, the index and the footer. Returns false if anything could not be written. */
+    bool finish();
+
+private:
+    bool flushBlock();
+
+    std::ofstream file;
+
+    std::vector<std::pair<Key, Element>> block;
+
+    std::vector<SortedFile::BlockHandle> index;
+
+    uint64_t offset;
+
+    uint64_t entryCount;
+};
+
+class SortedFileReader {
+public:
+    /** Opens the file and loads its index. Returns false if it does not exist or is not a sorted file. */
+    bool open(const std::string &path);
+
+    /** Get the Element associated with `key`. If the key is not found, return an empty optional. */
+    std::optional<Element> find(Key key);
+
+    uint64_t size() const;
+
+    uint64_t blockCount() const;
+
+private:
+    std::ifstream file;
+
+    std::vector<SortedFile::BlockHandle> index;
+
+    // reused buffer for the block that is currently searched
+    std::vector<std::pair<Key, Element>> block;
+
+    uint64_t entryCount = 0;
+};
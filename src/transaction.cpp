@@ -0,0 +1,138 @@
+#include "transaction.hpp"
+
+#include <algorithm>
+
+Transaction::Transaction(SkipList &list) : list(list), handle(list.handle()), failed(false), committed(false) {}
+
+std::optional<Element> Transaction::find(Key key) {
+    if (auto it = writes.find(key); it != writes.end()) {
+        return it->second.element;
+    }
+    std::atomic<uint64_t> *lock = list.keyLock(key);
+    if (lock == nullptr) {
+        return list.lookup(handle, key);
+    }
+    uint64_t version;
+    std::optional<Element> element = list.lookupUnlocked(handle, key, *lock, version);
+    reads.emplace_back(lock, version);
+    return element;
+}
+
+void Transaction::insert(Key key, Element element) {
+    auto [it, inserted] = writes.try_emplace(key, Write{false, element});
+    if (!inserted) {
+        // only valid if an earlier write of this transaction removed the key
+        failed |= it->second.element.has_value();
+        it->second.element = element;
+    }
+}
+
+void Transaction::remove(Key key) {
+    auto [it, inserted] = writes.try_emplace(key, Write{true, std::nullopt});
+    if (!inserted) {
+        failed |= !it->second.element.has_value();
+        it->second.element.reset();
+    }
+}
+
+void Transaction::update(Key key, Element element) {
+    auto [it, inserted] = writes.try_emplace(key, Write{true, element});
+    if (!inserted) {
+        failed |= !it->second.element.has_value();
+        it->second.element = element;
+    }
+}
+
+/*
+ * Stripes are locked in address order, so that commits with overlapping stripes cannot deadlock. While all written
+ * stripes are locked, nobody else can change the written keys, so the checked preconditions still hold when the
+ * writes are applied.
+ */
+bool Transaction::commit() {
+    if (failed || committed || list.keyLocks == nullptr || list.options.allowDuplicates || list.values != nullptr) {
+        return false;
+    }
+    committed = true;
+
+    std::vector<std::atomic<uint64_t> *> stripes{};
+    for (const auto &[key, write] : writes) {
+        stripes.push_back(list.keyLock(key));
+    }
+    std::sort(stripes.begin(), stripes.end());
+    stripes.erase(std::unique(stripes.begin(), stripes.end()), stripes.end());
+    for (std::atomic<uint64_t> *lock : stripes) {
+        locked.emplace_back(lock, SkipList::lockKey(*lock));
+    }
+
+    // freeze() takes all stripe locks, so the list cannot be frozen while the writes are applied
+    if (list.isFrozen()) {
+        release(false);
+        return false;
+    }
+    for (const auto &[lock, version] : reads) {
+        // a stripe that this transaction locked itself is compared by its version before locking
+        auto own = std::lower_bound(locked.begin(), locked.end(), std::make_pair(lock, uint64_t(0)));
+        uint64_t current = own != locked.end() && own->first == lock ? own->second : lock->load();
+        if (current != version) {
+            release(false);
+            return false;
+        }
+    }
+    for (const auto &[key, write] : writes) {
+        if (list.lookup(handle, key).has_value() != write.expectedPresent) {
+            release(false);
+            return false;
+        }
+    }
+
+    bool applied = apply();
+    release(true);
+    if (applied) {
+        list.evict(handle);
+    }
+    return applied;
+}
+
+/*
+ * An update replaces the tower, readers do not see the key missing in between because its stripe is locked. With the
+ * stripes locked and the list not frozen, a write only fails if eviction or expiry removed a key since the checks, then
+ * the writes before it are undone in reverse order (restored entries do not expire anymore).
+ */
+bool Transaction::apply() {
+    // keys that were written and their elements before
+    std::vector<std::pair<Key, std::optional<Element>>> applied{};
+    bool complete = true;
+    for (const auto &[key, write] : writes) {
+        std::optional<Element> before{};
+        if (write.expectedPresent) {
+            before = list.removeTower(handle, key);
+            if (!before.has_value()) {
+                complete = false;
+                break;
+            }
+        }
+        applied.emplace_back(key, before);
+        if (write.element.has_value() && list.insertTower(handle, key, *write.element, 0) == nullptr) {
+            complete = false;
+            break;
+        }
+    }
+    if (complete) {
+        return true;
+    }
+
+    for (auto it = applied.rbegin(); it != applied.rend(); ++it) {
+        list.removeTower(handle, it->first);
+        if (it->second.has_value()) {
+            list.insertTower(handle, it->first, *it->second, 0);
+        }
+    }
+    return false;
+}
+
+void Transaction::release(bool changed) {
+    for (const auto &[lock, version] : locked) {
+        lock->store(changed ? version + 2 : version, std::memory_order_release);
+    }
+    locked.clear();
+}
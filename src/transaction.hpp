@@ -0,0 +1,81 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include "skip_list.hpp"
+
+/**
+ * All-or-nothing batch of inserts, removes and updates of several keys of a SkipList that was created with
+ * SkipListOptions::transactional, e.g. to move an element from one key to another.
+ *
+ * Transactions are optimistic: operations only record what they want to change, and find() records the version of
+ * the lock of the key's stripe. commit() locks the stripes of all written keys in a fixed order, checks that no read
+ * stripe changed and that the preconditions of the writes still hold (insert: key absent, remove and update: key
+ * present), applies the writes and releases the locks with new versions. Single-key operations of the list lock the
+ * stripe of their key as well, and find() of the list waits for locked stripes, so neither sees a transaction half
+ * applied. Scans and iterators do not synchronize with transactions.
+ *
+ * Eviction and expiry are not synchronized with transactions, and lists with duplicate keys or variable-size values
+ * are not supported. A transaction is used by one thread and can be committed once.
+ */
+class Transaction {
+public:
+    explicit Transaction(SkipList &list);
+
+    /** The element of `key` including the writes of this transaction. Reads of other keys are validated by commit(). */
+    std::optional<Element> find(Key key);
+
+    /** Inserts `key`, which has to be absent at commit. */
+    void insert(Key key, Element element);
+
+    /** Removes `key`, which has to be present at commit. */
+    void remove(Key key);
+
+    /** Replaces the element of `key`, which has to be present at commit. */
+    void update(Key key, Element element);
+
+    /**
+     * Applies all writes atomically. Returns false without changing the list if a read key changed, a precondition does
+     * not hold, an operation contradicted an earlier one (e.g. removing a key twice), the list is frozen or does not
+     * support transactions. A transaction that failed because of a concurrent update can be retried with a new
+     * Transaction.
+     */
+    bool commit();
+
+private:
+    struct Write {
+        // whether the key has to be in the list before the transaction
+        bool expectedPresent;
+        // element of the key after the transaction, empty if it is removed
+        std::optional<Element> element;
+    };
+
+    // unlocks the stripes, with new versions if the transaction changed the list
+    void release(bool changed);
+
+    // applies the writes while the stripes are locked, returns false after undoing them if one could not be applied
+    bool apply();
+
+    SkipList &list;
+
+    // random stream and search results of the reads and writes
+    SkipList::Handle handle;
+
+    std::map<Key, Write> writes;
+
+    // stripe locks and their versions when they were read
+    std::vector<std::pair<std::atomic<uint64_t> *, uint64_t>> reads;
+
+    // stripe locks held by commit() and their versions before
+    std::vector<std::pair<std::atomic<uint64_t> *, uint64_t>> locked;
+
+    // set if an operation contradicted an earlier write
+    bool failed;
+
+    bool committed;
+};
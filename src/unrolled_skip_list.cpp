@@ -0,0 +1,159 @@
+#include "unrolled_skip_list.hpp"
+
+#include <algorithm>
+
+UnrolledSkipList::UnrolledSkipList() : first(new Chunk{MIN_KEY, new Block{0, false, MAX_KEY, {}}}) {}
+
+UnrolledSkipList::~UnrolledSkipList() {
+    // nobody uses the list anymore, so the current blocks can be freed right away
+    delete first->block.load();
+    delete first;
+    for (const auto &[low, chunk] : index) {
+        delete toChunk(chunk)->block.load();
+        delete toChunk(chunk);
+    }
+}
+
+UnrolledSkipList::Chunk *UnrolledSkipList::toChunk(Element element) {
+    return reinterpret_cast<Chunk *>(element);
+}
+
+UnrolledSkipList::Chunk *UnrolledSkipList::chunkFor(Key key) {
+    std::optional<Entry> floor = index.findFloor(key);
+    if (!floor.has_value()) {
+        return first;
+    }
+    return toChunk(floor->second);
+}
+
+bool UnrolledSkipList::movedOut(const Block *block, Key key) {
+    return !KeyCompare::equal(block->high, MAX_KEY) && !KeyCompare::less(key, block->high);
+}
+
+uint32_t UnrolledSkipList::lowerBound(const Block *block, Key key) {
+    return std::lower_bound(block->entries, block->entries + block->count, key,
+                            [](const Entry &entry, Key k) { return KeyCompare::less(entry.first, k); }) - block->entries;
+}
+
+std::optional<Element> UnrolledSkipList::find(Key key) {
+    auto guard = EpochManager::pin();
+    while (true) {
+        const Block *block = chunkFor(key)->block.load(std::memory_order_acquire);
+        if (movedOut(block, key)) {
+            continue; // the key moved to a new chunk after we looked up the index
+        }
+
+        uint32_t pos = lowerBound(block, key);
+        if (pos < block->count && KeyCompare::equal(block->entries[pos].first, key)) {
+            return block->entries[pos].second;
+        }
+        return {};
+    }
+}
+
+bool UnrolledSkipList::insert(Key key, Element element) {
+    auto guard = EpochManager::pin();
+    while (true) {
+        Chunk *chunk = chunkFor(key);
+        Block *block = chunk->block.load(std::memory_order_acquire);
+        if (movedOut(block, key)) {
+            continue; // the key moved to a new chunk after we looked up the index
+        }
+        if (block->frozen) {
+            helpSplit(chunk, block);
+            continue;
+        }
+
+        uint32_t pos = lowerBound(block, key);
+        if (pos < block->count && KeyCompare::equal(block->entries[pos].first, key)) {
+            return false; // DUPLICATE_KEYS
+        }
+
+        if (block->count == CHUNK_CAPACITY) {
+            // freeze a copy of the full block, then split it
+            auto *frozenBlock = new Block(*block);
+            frozenBlock->frozen = true;
+            if (chunk->block.compare_exchange_strong(block, frozenBlock)) {
+                EpochManager::retire(block);
+                helpSplit(chunk, frozenBlock);
+            } else {
+                delete frozenBlock;
+            }
+            continue;
+        }
+
+        // copy-on-write: new block with the entry inserted at pos
+        auto *newBlock = new Block{block->count + 1, false, block->high, {}};
+        std::copy(block->entries, block->entries + pos, newBlock->entries);
+        newBlock->entries[pos] = {key, element};
+        std::copy(block->entries + pos, block->entries + block->count, newBlock->entries + pos + 1);
+        if (chunk->block.compare_exchange_strong(block, newBlock)) {
+            EpochManager::retire(block);
+            return true;
+        }
+        delete newBlock;
+    }
+}
+
+std::optional<Element> UnrolledSkipList::remove(Key key) {
+    auto guard = EpochManager::pin();
+    while (true) {
+        Chunk *chunk = chunkFor(key);
+        Block *block = chunk->block.load(std::memory_order_acquire);
+        if (movedOut(block, key)) {
+            continue;
+        }
+        if (block->frozen) {
+            helpSplit(chunk, block);
+            continue;
+        }
+
+        uint32_t pos = lowerBound(block, key);
+        if (pos == block->count || !KeyCompare::equal(block->entries[pos].first, key)) {
+            return {}; // NO SUCH KEY
+        }
+
+        auto *newBlock = new Block{block->count - 1, false, block->high, {}};
+        std::copy(block->entries, block->entries + pos, newBlock->entries);
+        std::copy(block->entries + pos + 1, block->entries + block->count, newBlock->entries + pos);
+        if (chunk->block.compare_exchange_strong(block, newBlock)) {
+            Element element = block->entries[pos].second;
+            EpochManager::retire(block);
+            return element;
+        }
+        delete newBlock;
+    }
+}
+
+/*
+ * Every thread that sees the frozen block can run this, the steps are idempotent:
+ * 1. insert a chunk with the upper half into the index (only the first insert succeeds)
+ * 2. replace the frozen block by the lower half (only the first CAS succeeds)
+ */
+void UnrolledSkipList::helpSplit(Chunk *chunk, Block *frozenBlock) {
+    constexpr uint32_t half = CHUNK_CAPACITY / 2;
+    Key median = frozenBlock->entries[half].first;
+
+    auto *upperBlock = new Block{CHUNK_CAPACITY - half, false, frozenBlock->high, {}};
+    std::copy(frozenBlock->entries + half, frozenBlock->entries + CHUNK_CAPACITY, upperBlock->entries);
+    auto *upperChunk = new Chunk{median, upperBlock};
+    if (!index.insert(median, reinterpret_cast<Element>(upperChunk))) {
+        // another thread already inserted the upper chunk
+        delete upperBlock;
+        delete upperChunk;
+    }
+
+    // keys >= median are now found in the upper chunk
+    auto *lowerBlock = new Block{half, false, median, {}};
+    std::copy(frozenBlock->entries, frozenBlock->entries + half, lowerBlock->entries);
+    Block *expected = frozenBlock;
+    if (chunk->block.compare_exchange_strong(expected, lowerBlock)) {
+        EpochManager::retire(frozenBlock);
+    } else {
+        delete lowerBlock;
+    }
+}
+
+size_t UnrolledSkipList::chunkCount() {
+    return std::distance(index.begin(), index.end()) + 1;
+}
@@ -0,0 +1,127 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <optional>
+
+#include "epoch.hpp"
+#include "skip_list.hpp"
+
+/**
+ * Skip list with an unrolled data level: entries are stored in chunks of up to CHUNK_CAPACITY sorted entries, and a
+ * regular SkipList indexes the chunks by their lowest key. A lookup therefore touches one node per index level plus a
+ * single chunk, and scans read CHUNK_CAPACITY entries per cache miss instead of one.
+ *
+ * Chunks are updated lock-free with copy-on-write: every update builds a new immutable block of entries and swings the
+ * chunk's block pointer with a CAS. A full block is first replaced by a frozen copy, then the upper half moves to a new
+ * chunk that is inserted into the index, and finally the frozen block is replaced by the lower half. Threads that run
+ * into a frozen block help to finish the split. Replaced blocks are freed with epoch-based reclamation.
+ *
+ * Chunks are never merged or removed, so a chunk can become empty.
+ */
+class UnrolledSkipList {
+public:
+    static constexpr uint32_t CHUNK_CAPACITY = 16;
+
+    using Entry = SkipList::Entry;
+
+    UnrolledSkipList();
+
+    ~UnrolledSkipList();
+
+    UnrolledSkipList(const UnrolledSkipList &) = delete;
+
+    UnrolledSkipList &operator=(const UnrolledSkipList &) = delete;
+
+    /** Get the Element associated with `key`. If the key is not found, return an empty optional. */
+    std::optional<Element> find(Key key);
+
+    /** Insert the `element` associated with `key`. Return true on success, false for a duplicate key. */
+    bool insert(Key key, Element element);
+
+    /** Remove `key`. If it was removed, return its element, otherwise an empty optional. */
+    std::optional<Element> remove(Key key);
+
+    /**
+     * Calls `writer(entry)` for every entry with lo <= key <= hi in key order and stops early if it returns false.
+     * Returns the number of entries that were passed to the writer.
+     */
+    template<typename Writer>
+    size_t scanTo(Key lo, Key hi, Writer &&writer);
+
+    /** Number of chunks, i.e. entries of the index plus the first chunk. */
+    size_t chunkCount();
+
+private:
+    // immutable sorted run of entries
+    struct Block {
+        uint32_t count;
+        // set on the copy of a full block that is being split, it must not be modified anymore
+        bool frozen;
+        // exclusive upper bound of the keys this block is responsible for (MAX_KEY: unbounded), larger keys moved to
+        // another chunk
+        Key high;
+        Entry entries[CHUNK_CAPACITY];
+    };
+
+    struct Chunk {
+        Key low;
+        std::atomic<Block *> block;
+    };
+
+    // the chunk whose range contains key
+    Chunk *chunkFor(Key key);
+
+    // moves the upper half of the frozen block into a new chunk and replaces it by the lower half
+    void helpSplit(Chunk *chunk, Block *frozenBlock);
+
+    // true if key is not in the range of block anymore because it was split
+    static bool movedOut(const Block *block, Key key);
+
+    // position of the first entry >= key in block
+    static uint32_t lowerBound(const Block *block, Key key);
+
+    static Chunk *toChunk(Element element);
+
+    // index from the lowest key of a chunk to the chunk (stored as element), except for the first chunk
+    SkipList index;
+
+    // responsible for all keys smaller than the lowest key in the index
+    Chunk *first;
+};
+
+template<typename Writer>
+size_t UnrolledSkipList::scanTo(Key lo, Key hi, Writer &&writer) {
+    auto guard = EpochManager::pin();
+    size_t count = 0;
+    bool proceed = true;
+
+    // emits the entries of chunk, entries >= next->low already belong to the next chunk
+    auto emit = [&](Chunk *chunk, Chunk *next) {
+        const Block *block = chunk->block.load(std::memory_order_acquire);
+        for (uint32_t i = lowerBound(block, lo); i < block->count && proceed; i++) {
+            const Entry &entry = block->entries[i];
+            if (KeyCompare::less(hi, entry.first) || (next != nullptr && !KeyCompare::less(entry.first, next->low)) ||
+                movedOut(block, entry.first)) {
+                break;
+            }
+            count++;
+            proceed = writer(entry);
+        }
+    };
+
+    Chunk *current = chunkFor(lo);
+    index.scanTo(current->low, hi, [&](const Entry &entry) {
+        Chunk *next = toChunk(entry.second);
+        if (next == current) {
+            return true; // the index entry of the chunk the scan starts in
+        }
+        emit(current, next);
+        current = next;
+        return proceed;
+    });
+    if (proceed) {
+        emit(current, nullptr);
+    }
+    return count;
+}
@@ -0,0 +1,89 @@
+#include "value_arena.hpp"
+
+#include <cstring>
+#include <new>
+
+namespace {
+    // every value starts at an aligned address, so that its length can be read directly
+    constexpr size_t VALUE_ALIGNMENT = alignof(uint64_t);
+
+    constexpr size_t alignUp(size_t size) {
+        return (size + VALUE_ALIGNMENT - 1) & ~(VALUE_ALIGNMENT - 1);
+    }
+}
+
+ValueArena::ValueArena() : current(nullptr), chunks(nullptr), bytes(0) {
+    Chunk *chunk = newChunk(CHUNK_SIZE);
+    link(chunk);
+    current.store(chunk);
+}
+
+ValueArena::~ValueArena() {
+    Chunk *chunk = chunks.load();
+    while (chunk != nullptr) {
+        Chunk *next = chunk->next;
+        chunk->~Chunk();
+        ::operator delete(chunk);
+        chunk = next;
+    }
+}
+
+ValueArena::Chunk *ValueArena::newChunk(size_t capacity) {
+    void *memory = ::operator new(sizeof(Chunk) + capacity);
+    return new(memory) Chunk{capacity, 0, nullptr};
+}
+
+void ValueArena::link(Chunk *chunk) {
+    bytes.fetch_add(sizeof(Chunk) + chunk->capacity, std::memory_order_relaxed);
+    Chunk *head = chunks.load(std::memory_order_relaxed);
+    do {
+        chunk->next = head;
+    } while (!chunks.compare_exchange_weak(head, chunk, std::memory_order_release, std::memory_order_relaxed));
+}
+
+/*
+ * bumps the offset of the current chunk, if it is full the first thread to notice replaces it by a new one
+ */
+Element ValueArena::store(std::string_view value) {
+    size_t size = alignUp(sizeof(Value) + value.size());
+    char *address;
+
+    if (size > CHUNK_SIZE / 4) {
+        // large values would waste most of a regular chunk
+        Chunk *chunk = newChunk(size);
+        chunk->used.store(size, std::memory_order_relaxed);
+        link(chunk);
+        address = chunk->data();
+    } else {
+        while (true) {
+            Chunk *chunk = current.load(std::memory_order_acquire);
+            size_t offset = chunk->used.fetch_add(size, std::memory_order_relaxed);
+            if (offset + size <= chunk->capacity) {
+                address = chunk->data() + offset;
+                break;
+            }
+
+            Chunk *replacement = newChunk(CHUNK_SIZE);
+            if (current.compare_exchange_strong(chunk, replacement, std::memory_order_acq_rel)) {
+                link(replacement);
+            } else {
+                // replaced concurrently
+                replacement->~Chunk();
+                ::operator delete(replacement);
+            }
+        }
+    }
+
+    auto *copy = new(address) Value{value.size()};
+    std::memcpy(address + sizeof(Value), value.data(), value.size());
+    return reinterpret_cast<Element>(copy);
+}
+
+std::string_view ValueArena::view(Element element) {
+    const auto *value = reinterpret_cast<const Value *>(element);
+    return {value->bytes(), value->size};
+}
+
+size_t ValueArena::allocatedBytes() const {
+    return bytes.load(std::memory_order_relaxed);
+}
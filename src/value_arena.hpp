@@ -0,0 +1,73 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+#include "skip_list.hpp"
+
+/**
+ * Lock-free bump allocator for the variable-size values of a SkipList (SkipListOptions::variableSizeValues).
+ *
+ * A value is copied into a chunk together with its length and the entry stores the address of the copy as its Element,
+ * so reading a value needs no lookup besides the node. Like nodes, copies are never freed while the list exists, which
+ * keeps views into them stable: the values of removed and evicted entries are not reclaimed, so the arena grows with
+ * every insert. All chunks are freed when the arena is destroyed.
+ */
+class ValueArena {
+public:
+    // size of regular chunks, larger values get a chunk of their own
+    static constexpr size_t CHUNK_SIZE = size_t(1) << 20;
+
+    ValueArena();
+
+    ~ValueArena();
+
+    ValueArena(const ValueArena &) = delete;
+
+    ValueArena &operator=(const ValueArena &) = delete;
+
+    /** Copies `value` into the arena and returns the Element that refers to the copy. */
+    Element store(std::string_view value);
+
+    /** The value referred to by an Element that was returned by store(). */
+    static std::string_view view(Element element);
+
+    /** Bytes of all chunks. */
+    size_t allocatedBytes() const;
+
+private:
+    struct Chunk {
+        size_t capacity;
+        std::atomic<size_t> used;
+        // next older chunk, all chunks form a list for the destructor
+        Chunk *next;
+
+        char *data() {
+            return reinterpret_cast<char *>(this + 1);
+        }
+    };
+
+    // a stored value, followed by its bytes
+    struct Value {
+        size_t size;
+
+        const char *bytes() const {
+            return reinterpret_cast<const char *>(this + 1);
+        }
+    };
+
+    static Chunk *newChunk(size_t capacity);
+
+    // links a chunk into the list of all chunks
+    void link(Chunk *chunk);
+
+    // the chunk that is used for bump allocation
+    std::atomic<Chunk *> current;
+
+    // most recently created chunk
+    std::atomic<Chunk *> chunks;
+
+    std::atomic<size_t> bytes;
+};
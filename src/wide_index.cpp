@@ -0,0 +1,141 @@
+#include "wide_index.hpp"
+
+#include <bit>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+namespace {
+    uint32_t countLessScalar(const Key *keys, Key key) {
+        uint32_t count = 0;
+        for (size_t i = 0; i < WideIndex::KEYS_PER_NODE; i++) {
+            count += KeyCompare::less(keys[i], key);
+        }
+        return count;
+    }
+
+#if defined(__x86_64__)
+    static_assert(KeyCompare::NATIVE_ORDER, "the SIMD node searches compare keys as signed 64-bit integers");
+
+    __attribute__((target("avx2")))
+    uint32_t countLessAvx2(const Key *keys, Key key) {
+        __m256i search = _mm256_set1_epi64x(key);
+        __m256i low = _mm256_load_si256(reinterpret_cast<const __m256i *>(keys));
+        __m256i high = _mm256_load_si256(reinterpret_cast<const __m256i *>(keys + 4));
+        // one bit per byte of every 64 bit lane with key > keys[i]
+        auto lowMask = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpgt_epi64(search, low)));
+        auto highMask = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpgt_epi64(search, high)));
+        return (std::popcount(lowMask) + std::popcount(highMask)) / 8;
+    }
+
+    __attribute__((target("avx512f")))
+    uint32_t countLessAvx512(const Key *keys, Key key) {
+        __m512i search = _mm512_set1_epi64(key);
+        __m512i node = _mm512_load_si512(keys);
+        return std::popcount(static_cast<uint32_t>(_mm512_cmplt_epi64_mask(node, search)));
+    }
+#endif
+}
+
+WideIndex::WideIndex(std::span<const SkipList::Entry> entries, Isa isa) {
+    switch (isa) {
+#if defined(__x86_64__)
+        case Isa::Avx512:
+            countLess = countLessAvx512;
+            break;
+        case Isa::Avx2:
+            countLess = countLessAvx2;
+            break;
+#endif
+        default:
+            countLess = countLessScalar;
+            break;
+    }
+
+    elements.reserve(entries.size());
+    std::vector<Key> keys{};
+    keys.reserve(entries.size());
+    for (const auto &[key, element] : entries) {
+        keys.push_back(key);
+        elements.push_back(element);
+    }
+
+    // pack the keys into nodes, then build the next level from the largest key of every node until one node is left
+    while (!keys.empty()) {
+        std::vector<WideNode> &level = levels.emplace_back((keys.size() + KEYS_PER_NODE - 1) / KEYS_PER_NODE);
+        std::vector<Key> maxKeys{};
+        for (size_t n = 0; n < level.size(); n++) {
+            for (size_t i = 0; i < KEYS_PER_NODE; i++) {
+                size_t pos = n * KEYS_PER_NODE + i;
+                level[n].keys[i] = pos < keys.size() ? keys[pos] : MAX_KEY;
+            }
+            maxKeys.push_back(keys[std::min(keys.size(), (n + 1) * KEYS_PER_NODE) - 1]);
+        }
+        if (level.size() == 1) {
+            break;
+        }
+        keys = std::move(maxKeys);
+    }
+}
+
+/*
+ * Descends from the root node: the child at position i of a node contains the keys between the largest keys of its
+ * left neighbour and of itself, so the number of keys smaller than key is the child that contains the lower bound.
+ */
+std::optional<Element> WideIndex::find(Key key) const {
+    if (elements.empty()) {
+        return {};
+    }
+
+    size_t node = 0;
+    for (size_t level = levels.size() - 1; level > 0; level--) {
+        node = node * KEYS_PER_NODE + countLess(levels[level][node].keys, key);
+        if (node >= levels[level - 1].size()) {
+            return {}; // larger than all keys
+        }
+    }
+
+    const WideNode &leaf = levels[0][node];
+    uint32_t pos = countLess(leaf.keys, key);
+    // padding slots hold MAX_KEY, which can be a key of an entry as well
+    if (pos < KEYS_PER_NODE && node * KEYS_PER_NODE + pos < elements.size() && KeyCompare::equal(leaf.keys[pos], key)) {
+        return elements[node * KEYS_PER_NODE + pos];
+    }
+    return {};
+}
+
+size_t WideIndex::size() const {
+    return elements.size();
+}
+
+bool WideIndex::supported(Isa isa) {
+    switch (isa) {
+#if defined(__x86_64__)
+        case Isa::Avx512:
+            return __builtin_cpu_supports("avx512f");
+        case Isa::Avx2:
+            return __builtin_cpu_supports("avx2");
+#endif
+        case Isa::Scalar:
+            return true;
+        default:
+            return false;
+    }
+}
+
+WideIndex::Isa WideIndex::bestIsa() {
+    static const Isa best = supported(Isa::Avx512) ? Isa::Avx512 : supported(Isa::Avx2) ? Isa::Avx2 : Isa::Scalar;
+    return best;
+}
+
+const char *WideIndex::name(Isa isa) {
+    switch (isa) {
+        case Isa::Avx512:
+            return "avx512";
+        case Isa::Avx2:
+            return "avx2";
+        default:
+            return "scalar";
+    }
+}
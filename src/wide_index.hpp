@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <utility>
+#include <vector>
+
+#include "skip_list.hpp"
+
+/**
+ * Static read-only search index over sorted entries, used to speed up lookups in a frozen skip list.
+ *
+ * Instead of one key per index node, every node holds KEYS_PER_NODE keys in one cache line. Level 0 contains all keys,
+ * every level above stores the largest key of each node of the level below, so the children of a node are implicit and
+ * no down pointers are needed. A lookup compares the search key against all keys of a node at once and descends into
+ * the child at the number of keys that are smaller, i.e. one cache line per level instead of one pointer hop per key.
+ *
+ * The node search uses AVX-512 or AVX2 compares if the CPU supports them and a scalar loop otherwise.
+ */
+class WideIndex {
+public:
+    static constexpr size_t KEYS_PER_NODE = 8;
+
+    // implementation of the node search
+    enum class Isa {
+        Scalar,
+        Avx2,
+        Avx512,
+    };
+
+    /** Builds the index over `entries`, which have to be sorted by strictly increasing keys. */
+    explicit WideIndex(std::span<const SkipList::Entry> entries, Isa isa = bestIsa());
+
+    /** Get the Element associated with `key`. If the key is not found, return an empty optional. */
+    std::optional<Element> find(Key key) const;
+
+    size_t size() const;
+
+    /** Whether the CPU can run the node search with `isa`. */
+    static bool supported(Isa isa);
+
+    /** The fastest node search the CPU supports. */
+    static Isa bestIsa();
+
+    static const char *name(Isa isa);
+
+private:
+    struct alignas(64) WideNode {
+        Key keys[KEYS_PER_NODE];
+    };
+
+    // number of keys in node that are smaller than key
+    using CountLess = uint32_t (*)(const Key *keys, Key key);
+
+    // levels[0] holds all keys, the last level is a single root node, unused slots are filled with MAX_KEY
+    std::vector<std::vector<WideNode>> levels;
+
+    std::vector<Element> elements;
+
+    CountLess countLess;
+};
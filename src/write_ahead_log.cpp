@@ -0,0 +1,214 @@
+#include "write_ahead_log.hpp"
+#include "checksum.hpp"
+
+#include <bit>
+#include <cstddef>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+
+namespace {
+    uint32_t recordChecksum(const LogRecord &record) {
+        uint32_t crc = crc32c(&record, offsetof(LogRecord, checksum));
+        return crc32c(&record.key, sizeof(LogRecord) - offsetof(LogRecord, key), crc);
+    }
+
+    // holds the lock of a key stripe, waiting threads sleep until it is released
+    class StripeGuard {
+    public:
+        explicit StripeGuard(std::atomic<bool> &lock) : lock(lock) {
+            while (lock.exchange(true, std::memory_order_acquire)) {
+                lock.wait(true, std::memory_order_relaxed);
+            }
+        }
+
+        ~StripeGuard() {
+            lock.store(false, std::memory_order_release);
+            lock.notify_one();
+        }
+
+        StripeGuard(const StripeGuard &) = delete;
+
+        StripeGuard &operator=(const StripeGuard &) = delete;
+
+    private:
+        std::atomic<bool> &lock;
+    };
+}
+
+/*
+ * WRITE-AHEAD LOG
+ */
+std::unique_ptr<WriteAheadLog> WriteAheadLog::open(const std::string &path, std::chrono::microseconds batchWindow,
+                                                   const std::function<void(const LogRecord &)> &replay) {
+    int fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+        return nullptr;
+    }
+
+    // replay until the first record that is torn or out of sequence
+    uint64_t lsn = 0;
+    LogRecord record{};
+    while (pread(fd, &record, sizeof(record), static_cast<off_t>(lsn * sizeof(LogRecord))) == sizeof(record) &&
+           record.lsn == lsn && record.checksum == recordChecksum(record)) {
+        replay(record);
+        lsn++;
+    }
+    if (ftruncate(fd, static_cast<off_t>(lsn * sizeof(LogRecord))) != 0) {
+        ::close(fd);
+        return nullptr;
+    }
+
+    return std::unique_ptr<WriteAheadLog>(new WriteAheadLog(fd, lsn, batchWindow));
+}
+
+WriteAheadLog::WriteAheadLog(int fd, uint64_t nextLsn, std::chrono::microseconds batchWindow)
+        : fd(fd), batchWindow(batchWindow), nextLsn(nextLsn), durableLsn(nextLsn), flushing(false), failed(false),
+          syncCount(0), ring(new Slot[RING_SIZE]) {
+    batch.reserve(RING_SIZE);
+}
+
+WriteAheadLog::~WriteAheadLog() {
+    ::close(fd);
+}
+
+bool WriteAheadLog::append(LogRecord::Operation operation, Key key, Element element) {
+    uint64_t lsn = nextLsn.fetch_add(1);
+
+    // the slot is still used by the record one lap earlier until that one is durable
+    uint64_t durable = durableLsn.load(std::memory_order_acquire);
+    while (lsn >= durable && lsn - durable >= RING_SIZE) {
+        durableLsn.wait(durable);
+        durable = durableLsn.load(std::memory_order_acquire);
+    }
+
+    Slot &slot = ring[lsn % RING_SIZE];
+    slot.record = {lsn, operation, 0, key, element};
+    slot.record.checksum = recordChecksum(slot.record);
+    slot.sequence.store(lsn + 1, std::memory_order_release);
+
+    return commit(lsn);
+}
+
+bool WriteAheadLog::commit(uint64_t lsn) {
+    uint64_t durable = durableLsn.load(std::memory_order_acquire);
+    while (durable <= lsn) {
+        bool expected = false;
+        if (flushing.compare_exchange_strong(expected, true, std::memory_order_acquire)) {
+            // leader: give other threads the batch window to publish their records, then flush all of them at once
+            if (durableLsn.load() <= lsn && batchWindow.count() > 0) {
+                std::this_thread::sleep_for(batchWindow);
+            }
+            if (!flushPublished()) {
+                // wake up everybody so they can see the failure
+                failed.store(true);
+                durableLsn.store(UINT64_MAX);
+                durableLsn.notify_all();
+            }
+            flushing.store(false, std::memory_order_release);
+            flushing.notify_all();
+        } else {
+            // follower: wait for the current leader and check again, its commit group might not contain our record
+            flushing.wait(true, std::memory_order_acquire);
+        }
+        durable = durableLsn.load(std::memory_order_acquire);
+    }
+    return !failed.load();
+}
+
+bool WriteAheadLog::flushPublished() {
+    uint64_t start = durableLsn.load();
+    uint64_t end = start;
+    uint64_t reserved = nextLsn.load();
+
+    batch.clear();
+    while (end < reserved && ring[end % RING_SIZE].sequence.load(std::memory_order_acquire) == end + 1) {
+        batch.push_back(ring[end % RING_SIZE].record);
+        end++;
+    }
+    if (end == start) {
+        // the oldest reserved record is not published yet, its owner will be done soon
+        std::this_thread::yield();
+        return true;
+    }
+
+    auto bytes = static_cast<ssize_t>(batch.size() * sizeof(LogRecord));
+    if (pwrite(fd, batch.data(), bytes, static_cast<off_t>(start * sizeof(LogRecord))) != bytes || fdatasync(fd) != 0) {
+        return false;
+    }
+    syncCount.fetch_add(1, std::memory_order_relaxed);
+
+    durableLsn.store(end, std::memory_order_release);
+    durableLsn.notify_all();
+    return true;
+}
+
+uint64_t WriteAheadLog::durableRecords() const {
+    return failed.load() ? 0 : durableLsn.load();
+}
+
+uint64_t WriteAheadLog::syncs() const {
+    return syncCount.load();
+}
+
+/*
+ * DURABLE SKIP LIST
+ */
+DurableSkipList::DurableSkipList() : keyLocks(std::make_unique<std::atomic<bool>[]>(KEY_LOCKS)) {}
+
+/*
+ * stripes are chosen by a multiplicative hash like the ones of SkipListOptions::transactional
+ */
+std::atomic<bool> &DurableSkipList::keyLock(Key key) {
+    uint64_t hash = static_cast<uint64_t>(key) * 0x9E3779B97F4A7C15ull;
+    return keyLocks[hash >> (64 - std::countr_zero(KEY_LOCKS))];
+}
+
+std::unique_ptr<DurableSkipList> DurableSkipList::open(const std::string &path, std::chrono::microseconds batchWindow) {
+    std::unique_ptr<DurableSkipList> durable(new DurableSkipList());
+    durable->writeAheadLog = WriteAheadLog::open(path, batchWindow, [&](const LogRecord &record) {
+        if (record.operation == LogRecord::Operation::Insert) {
+            durable->skipList.insert(record.key, record.element);
+        } else {
+            durable->skipList.remove(record.key);
+        }
+    });
+    if (durable->writeAheadLog == nullptr) {
+        return nullptr;
+    }
+    return durable;
+}
+
+std::optional<Element> DurableSkipList::find(Key key) {
+    return skipList.find(key);
+}
+
+/*
+ * Only the operations of this class change the list, so while the stripe is locked the outcome checked before logging
+ * is the outcome of applying the record
+ */
+bool DurableSkipList::insert(Key key, Element element) {
+    StripeGuard lock(keyLock(key));
+    if (skipList.find(key).has_value() || !writeAheadLog->append(LogRecord::Operation::Insert, key, element)) {
+        return false;
+    }
+    return skipList.insert(key, element);
+}
+
+std::optional<Element> DurableSkipList::remove(Key key) {
+    StripeGuard lock(keyLock(key));
+    std::optional<Element> element = skipList.find(key);
+    if (!element.has_value() || !writeAheadLog->append(LogRecord::Operation::Remove, key, *element)) {
+        return {};
+    }
+    return skipList.remove(key);
+}
+
+SkipList &DurableSkipList::list() {
+    return skipList;
+}
+
+WriteAheadLog &DurableSkipList::log() {
+    return *writeAheadLog;
+}
@@ -0,0 +1,143 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "skip_list.hpp"
+
+struct LogRecord {
+    enum class Operation : uint32_t {
+        Insert = 1,
+        Remove = 2,
+    };
+
+    uint64_t lsn;
+    Operation operation;
+    // crc32c of all other fields, detects torn writes at the end of the log
+    uint32_t checksum;
+    Key key;
+    Element element;
+};
+
+/**
+ * Append-only log with group commit. Threads reserve a log sequence number (LSN) with a single fetch_add and publish
+ * their record in a ring buffer. The first waiting thread that finds no flush in progress becomes the leader: it waits
+ * for the batch window, writes all records that are published without a gap and syncs the file once for all of them.
+ * The other threads wait for the leader to finish and then check whether their record is durable or whether they have
+ * to lead the next commit group themselves, no mutex is involved.
+ */
+class WriteAheadLog {
+public:
+    /**
+     * Opens or creates the log at `path` and calls `replay` for every valid record in LSN order. The log is truncated
+     * behind the last valid record (e.g. a torn write). Returns nullptr if the file cannot be opened.
+     */
+    static std::unique_ptr<WriteAheadLog> open(const std::string &path, std::chrono::microseconds batchWindow,
+                                               const std::function<void(const LogRecord &)> &replay);
+
+    ~WriteAheadLog();
+
+    WriteAheadLog(const WriteAheadLog &) = delete;
+
+    WriteAheadLog &operator=(const WriteAheadLog &) = delete;
+
+    /** Appends a record and returns once it is durable. Returns false if the log could not be written. */
+    bool append(LogRecord::Operation operation, Key key, Element element);
+
+    /** Number of records that are durable. */
+    uint64_t durableRecords() const;
+
+    /** Number of file syncs, i.e. commit groups, since the log was opened. */
+    uint64_t syncs() const;
+
+private:
+    // number of records that can be in flight, reserving more waits until the oldest ones are durable
+    static constexpr uint64_t RING_SIZE = 4096;
+
+    struct Slot {
+        // lsn + 1 once the record of lsn is published, so an old lap of the ring is not mistaken for it
+        std::atomic<uint64_t> sequence{0};
+        LogRecord record;
+    };
+
+    WriteAheadLog(int fd, uint64_t nextLsn, std::chrono::microseconds batchWindow);
+
+    // waits until lsn is durable and becomes the flushing leader if nobody else is
+    bool commit(uint64_t lsn);
+
+    // writes and syncs all records that are published without a gap, only called by the leader
+    bool flushPublished();
+
+    int fd;
+
+    std::chrono::microseconds batchWindow;
+
+    std::atomic<uint64_t> nextLsn;
+
+    // all records with a smaller lsn are durable
+    std::atomic<uint64_t> durableLsn;
+
+    // set while a leader writes a commit group
+    std::atomic<bool> flushing;
+
+    // set if a write or sync failed, the log does not accept records afterwards
+    std::atomic<bool> failed;
+
+    std::atomic<uint64_t> syncCount;
+
+    std::unique_ptr<Slot[]> ring;
+
+    // records of the current commit group, only used by the leader
+    std::vector<LogRecord> batch;
+};
+
+/**
+ * SkipList whose inserts and removes are logged in a WriteAheadLog and replayed when it is opened again.
+ *
+ * An operation locks the stripe of its key, checks that it would succeed, appends its record and waits until the
+ * record is durable, and only then applies it to the list. So readers never see a change that is not durable, a failed
+ * append leaves the list unchanged, and operations on the same key are logged in the order in which they are applied.
+ * Operations on keys of different stripes share commit groups.
+ */
+class DurableSkipList {
+public:
+    /** Opens the log at `path` and rebuilds the list from it. Returns nullptr if the log cannot be opened. */
+    static std::unique_ptr<DurableSkipList> open(const std::string &path,
+                                                 std::chrono::microseconds batchWindow = std::chrono::microseconds(0));
+
+    /** Get the Element associated with `key`. If the key is not found, return an empty optional. */
+    std::optional<Element> find(Key key);
+
+    /** Insert the `element` associated with `key`. Returns true once the insert is durable, false otherwise. */
+    bool insert(Key key, Element element);
+
+    /** Remove `key`. Returns the removed element once the remove is durable, otherwise an empty optional. */
+    std::optional<Element> remove(Key key);
+
+    /** The list that the log is replayed into. Changes made directly to it are not logged. */
+    SkipList &list();
+
+    WriteAheadLog &log();
+
+private:
+    DurableSkipList();
+
+    // lock of the stripe of key
+    std::atomic<bool> &keyLock(Key key);
+
+    // number of key stripes, a power of two
+    static constexpr size_t KEY_LOCKS = 1024;
+
+    SkipList skipList;
+
+    std::unique_ptr<WriteAheadLog> writeAheadLog;
+
+    // held by an operation from checking its key until it is applied
+    std::unique_ptr<std::atomic<bool>[]> keyLocks;
+};
@@ -1,15 +1,28 @@
 #include <algorithm>
 #include <array>
 #include <barrier>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <map>
 #include <numeric>
 #include <random>
 #include <thread>
 #include <unordered_set>
 #include <vector>
+#include <sys/wait.h>
+#include <unistd.h>
 
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
 #include "skip_list.hpp"
+#include "sorted_file.hpp"
+#include "persistent_skip_list.hpp"
+#include "write_ahead_log.hpp"
+#include "unrolled_skip_list.hpp"
+#include "wide_index.hpp"
+#include "value_arena.hpp"
+#include "transaction.hpp"
 
 #define matches_array(sl, expected)                                                   \
   ({                                                                                  \
@@ -87,6 +100,26 @@ TEST(SuccessorTest, Successor) {
     ASSERT_TRUE(flaggedSuccessor.flagged());
 }
 
+#ifdef COMPACT_NODE_REFS
+TEST(SuccessorTest, CompactNodeRefs) {
+    ASSERT_EQ(sizeof(Successor), sizeof(uint32_t));
+    ASSERT_EQ(sizeof(NodeRef), sizeof(uint32_t));
+
+    Node *root = new Node(1, 1);
+    Node *node = new Node(1, root, root);
+    ASSERT_GT(NodeArena::allocatedNodes(), 0u);
+
+    ASSERT_EQ(static_cast<Node *>(node->down), root);
+    ASSERT_EQ(node->towerRoot->key(), 1);
+    ASSERT_EQ(static_cast<Node *>(root->down), nullptr);
+
+    Successor markedSuccessor{node, true, false};
+    ASSERT_EQ(markedSuccessor.right(), node);
+    ASSERT_TRUE(markedSuccessor.marked());
+    ASSERT_EQ(Successor(nullptr, false, true).right(), nullptr);
+}
+#endif
+
 
 /////////////////////////////
 /// SINGLE-THREADED TESTS ///
@@ -190,6 +223,39 @@ TEST(SingleThreadedSkipListTest, IteratorInterface) {
   matches_array(sl, expected);
 }
 
+TEST(SingleThreadedSkipListTest, RangeScan) {
+    SkipList sl{};
+    for (Key key = 0; key < 100; ++key) {
+        ASSERT_TRUE(sl.insert(key * 2, key));
+    }
+    ASSERT_TRUE(sl.remove(20).has_value());
+
+    // chunked scan of [11, 31] into a small buffer
+    std::array<SkipList::Entry, 4> buffer{};
+    std::vector<SkipList::Entry> result{};
+    Key lo = 11;
+    size_t count;
+    while ((count = sl.scanInto(lo, 31, buffer)) > 0) {
+        result.insert(result.end(), buffer.begin(), buffer.begin() + count);
+        lo = buffer[count - 1].first + 1;
+    }
+    std::vector<SkipList::Entry> expected{{12, 6}, {14, 7}, {16, 8}, {18, 9}, {22, 11},
+                                          {24, 12}, {26, 13}, {28, 14}, {30, 15}};
+    ASSERT_EQ(result, expected);
+
+    // zero-copy: the iovecs point into the skip list
+    std::array<iovec, 8> iov{};
+    ASSERT_EQ(sl.scanIovec(190, MAX_KEY, iov), 5u);
+    const auto *entry = static_cast<const SkipList::Entry *>(iov[4].iov_base);
+    ASSERT_EQ(iov[4].iov_len, sizeof(SkipList::Entry));
+    ASSERT_EQ(*entry, SkipList::Entry(198, 99));
+
+    // the writer can stop the scan
+    size_t seen = sl.scanTo(MIN_KEY, MAX_KEY, [](const SkipList::Entry &e) { return e.first < 10; });
+    ASSERT_EQ(seen, 6u);
+    ASSERT_EQ(sl.scanInto(1000, 2000, buffer), 0u);
+}
+
 TEST(SingleThreadedSkipListTest, SimpleInsertAndRemoveOwn) {
     SkipList sl{};
     ASSERT_TRUE(sl.insert(10, 100));
@@ -264,6 +330,33 @@ TEST(SingleThreadedSkipListTest, InsertFindDelete) {
     }
 }
 
+TEST(SingleThreadedSkipListTest, RemoveUnlinksWholeTower) {
+    const int num_entries = 1000;
+    const Key kept = 500;
+    for (bool allowDuplicates : {false, true}) {
+        SkipList sl{{.allowDuplicates = allowDuplicates}};
+        for (Key key = 0; key < num_entries; ++key) {
+            ASSERT_TRUE(sl.insert(key, key));
+            if (allowDuplicates) {
+                ASSERT_TRUE(sl.insert(key, -key));
+            }
+        }
+        for (Key key = 0; key < num_entries; ++key) {
+            if (key != kept) {
+                ASSERT_EQ(sl.removeAll(key), allowDuplicates ? 2u : 1u);
+            }
+        }
+        ASSERT_EQ(sl.size(), allowDuplicates ? 2u : 1u);
+        if (!allowDuplicates) {
+            // only the levels of the tower of the kept key are left, so the search finds it right behind the head
+            ASSERT_EQ(sl.searchCost(kept), 2u);
+        }
+        // no index node is left behind, so an empty list is searched on level 1 only
+        sl.removeAll(kept);
+        ASSERT_EQ(sl.searchCost(kept), 1u);
+    }
+}
+
 
 ////////////////////////////
 /// MULTI-THREADED TESTS ///
@@ -332,7 +425,7 @@ TEST(MultiThreadedSkipListTest, InsertFindAndRemoveAll) {
         ASSERT_TRUE(element.has_value());
     }
 
-    std::array<bool, 2> no_crash{};
+    std::array<bool, num_threads> no_crash{};
     std::barrier start_threads{num_threads};
     auto remove_fn = [&](int id) {
         start_threads.arrive_and_wait();  // Wait for all threads to be ready.
@@ -447,6 +540,1739 @@ TEST(MultiThreadedSkipListTest, InsertRemoveFind) {
   EXPECT_TRUE(std::is_sorted(sl.begin(), sl.end()));
 }
 
+//////////////////////
+/// MEMTABLE TESTS ///
+//////////////////////
+
+TEST(MemtableTest, FreezeRejectsModifications) {
+    SkipList sl{};
+    ASSERT_TRUE(sl.insert(1, 10));
+    ASSERT_TRUE(sl.insert(2, 20));
+    ASSERT_TRUE(sl.remove(2).has_value());
+
+    sl.freeze();
+    ASSERT_TRUE(sl.isFrozen());
+    ASSERT_FALSE(sl.insert(3, 30));
+    ASSERT_FALSE(sl.remove(1).has_value());
+
+    matches_element(sl.find(1), 10);
+    ASSERT_FALSE(sl.find(2).has_value());
+    ASSERT_FALSE(sl.find(3).has_value());
+}
+
+TEST(MemtableTest, FlushToSortedFile) {
+    const int num_entries = 2000;
+    const auto path = std::filesystem::temp_directory_path() / "skip_list_memtable_test.sst";
+    SkipList sl{};
+
+    for (Key key = 0; key < num_entries; ++key) {
+        ASSERT_TRUE(sl.insert(key * 2, key));
+    }
+    for (Key key = 0; key < num_entries; key += 3) {
+        ASSERT_TRUE(sl.remove(key * 2).has_value());
+    }
+
+    ASSERT_FALSE(sl.flush(path)) << "Only frozen lists can be flushed.";
+    sl.freeze();
+    ASSERT_TRUE(sl.flush(path));
+
+    SortedFileReader reader{};
+    ASSERT_TRUE(reader.open(path));
+    ASSERT_EQ(reader.size(), static_cast<uint64_t>(std::distance(sl.begin(), sl.end())));
+    ASSERT_GT(reader.blockCount(), 1u);
+
+    for (Key key = 0; key < num_entries; ++key) {
+        if (key % 3 == 0) {
+            ASSERT_FALSE(reader.find(key * 2).has_value());
+        } else {
+            matches_element(reader.find(key * 2), key);
+        }
+        ASSERT_FALSE(reader.find(key * 2 + 1).has_value());
+    }
+    std::filesystem::remove(path);
+}
+
+//////////////////////
+/// SNAPSHOT TESTS ///
+//////////////////////
+
+TEST(SnapshotTest, SaveAndLoad) {
+    const int num_entries = 10000;
+    const auto path = std::filesystem::temp_directory_path() / "skip_list_snapshot_test.bin";
+    SkipList sl{};
+
+    std::vector<SkipList::Entry> expected{};
+    for (Key key = -num_entries; key < num_entries; key += 2) {
+        ASSERT_TRUE(sl.insert(key * 1000, -key));
+        expected.emplace_back(key * 1000, -key);
+    }
+    ASSERT_TRUE(sl.insert(MIN_KEY + 1, 1));
+    ASSERT_TRUE(sl.insert(MAX_KEY - 1, 2));
+    expected.insert(expected.begin(), {MIN_KEY + 1, 1});
+    expected.emplace_back(MAX_KEY - 1, 2);
+    ASSERT_TRUE(sl.save(path));
+
+    SkipList loaded{};
+    ASSERT_TRUE(loaded.load(path));
+    matches_array(loaded, expected);
+    for (const auto &[key, element] : expected) {
+        matches_element(loaded.find(key), element);
+    }
+
+    // the loaded list is a regular list afterwards
+    ASSERT_TRUE(loaded.insert(1, 1));
+    ASSERT_FALSE(loaded.insert(0, 0));
+    std::optional<Element> removed = loaded.remove(0);
+    matches_element(removed, 0);
+    ASSERT_FALSE(loaded.find(0).has_value());
+
+    ASSERT_FALSE(loaded.load(path)) << "Loading requires an empty list.";
+    std::filesystem::remove(path);
+}
+
+TEST(SnapshotTest, DetectCorruption) {
+    const auto path = std::filesystem::temp_directory_path() / "skip_list_snapshot_corrupt.bin";
+    SkipList sl{};
+    for (Key key = 0; key < 100; ++key) {
+        ASSERT_TRUE(sl.insert(key, key));
+    }
+    ASSERT_TRUE(sl.save(path));
+
+    {
+        std::fstream file(path, std::ios::binary | std::ios::in | std::ios::out);
+        file.seekp(30);
+        file.put('\x7f');
+    }
+
+    SkipList loaded{};
+    ASSERT_FALSE(loaded.load(path));
+    SkipList missing{};
+    ASSERT_FALSE(missing.load(path.string() + ".missing"));
+    std::filesystem::remove(path);
+}
+
+//////////////////////////////////
+/// PERSISTENT SKIP LIST TESTS ///
+//////////////////////////////////
+
+TEST(PersistentSkipListTest, ReopenWithoutRebuild) {
+    const int num_entries = 1000;
+    const auto path = std::filesystem::temp_directory_path() / "skip_list_persistent_test.map";
+    std::filesystem::remove(path);
+
+    std::vector<SkipList::Entry> expected{};
+    {
+        auto sl = PersistentSkipList::open(path, 1 << 20, PersistentSkipList::Durability::OnSync);
+        ASSERT_NE(sl, nullptr);
+        for (Key key = 0; key < num_entries; ++key) {
+            ASSERT_TRUE(sl->insert(key, key * 10));
+        }
+        for (Key key = 0; key < num_entries; key += 2) {
+            std::optional<Element> element = sl->remove(key);
+            matches_element(element, key * 10);
+        }
+    }
+
+    auto sl = PersistentSkipList::open(path, 1 << 20);
+    ASSERT_NE(sl, nullptr);
+    for (Key key = 1; key < num_entries; key += 2) {
+        expected.emplace_back(key, key * 10);
+        matches_element(sl->find(key), key * 10);
+        ASSERT_FALSE(sl->find(key - 1).has_value());
+    }
+    ASSERT_EQ(sl->entries(), expected);
+
+    ASSERT_FALSE(sl->insert(1, 1));
+    ASSERT_TRUE(sl->insert(0, 0));
+    matches_element(sl->find(0), 0);
+    std::filesystem::remove(path);
+}
+
+TEST(PersistentSkipListTest, FullMapping) {
+    const auto path = std::filesystem::temp_directory_path() / "skip_list_persistent_full.map";
+    std::filesystem::remove(path);
+
+    auto sl = PersistentSkipList::open(path, 0, PersistentSkipList::Durability::OnSync);
+    ASSERT_NE(sl, nullptr);
+    Key key = 0;
+    while (sl->insert(key, key)) {
+        key++;
+    }
+    ASSERT_GT(key, 0);
+    for (Key k = 0; k < key; ++k) {
+        matches_element(sl->find(k), k);
+    }
+    std::filesystem::remove(path);
+}
+
+TEST(PersistentSkipListTest, SurvivesCrash) {
+    const int num_entries = 200;
+    const auto path = std::filesystem::temp_directory_path() / "skip_list_persistent_crash.map";
+    std::filesystem::remove(path);
+
+    pid_t child = fork();
+    ASSERT_GE(child, 0);
+    if (child == 0) {
+        auto sl = PersistentSkipList::open(path, 1 << 20);
+        for (Key key = 0; key < num_entries; ++key) {
+            sl->insert(key, key);
+        }
+        for (Key key = 0; key < num_entries; key += 4) {
+            sl->remove(key);
+        }
+        // crash: neither the destructor nor sync() run
+        _exit(0);
+    }
+    int status;
+    waitpid(child, &status, 0);
+
+    auto sl = PersistentSkipList::open(path, 1 << 20);
+    ASSERT_NE(sl, nullptr);
+    for (Key key = 0; key < num_entries; ++key) {
+        if (key % 4 == 0) {
+            ASSERT_FALSE(sl->find(key).has_value());
+        } else {
+            matches_element(sl->find(key), key);
+        }
+    }
+    std::filesystem::remove(path);
+}
+
+TEST(PersistentSkipListTest, SentinelKeysAreValid) {
+    const auto path = std::filesystem::temp_directory_path() / "skip_list_persistent_sentinels.map";
+    std::filesystem::remove(path);
+
+    {
+        auto sl = PersistentSkipList::open(path, 1 << 20, PersistentSkipList::Durability::OnSync);
+        ASSERT_NE(sl, nullptr);
+        ASSERT_FALSE(sl->find(MIN_KEY).has_value());
+        ASSERT_FALSE(sl->find(MAX_KEY).has_value());
+        ASSERT_FALSE(sl->remove(MIN_KEY).has_value());
+        ASSERT_FALSE(sl->remove(MAX_KEY).has_value());
+
+        for (Key key : {MAX_KEY, Key(0), MIN_KEY, MAX_KEY - 1, MIN_KEY + 1}) {
+            ASSERT_TRUE(sl->insert(key, key / 2));
+            ASSERT_FALSE(sl->insert(key, key / 2));
+        }
+        std::optional<Element> removed = sl->remove(MAX_KEY - 1);
+        matches_element(removed, (MAX_KEY - 1) / 2);
+        removed = sl->remove(MIN_KEY + 1);
+        matches_element(removed, (MIN_KEY + 1) / 2);
+    }
+
+    auto sl = PersistentSkipList::open(path, 1 << 20);
+    ASSERT_NE(sl, nullptr);
+    const std::vector<SkipList::Entry> expected{{MIN_KEY, MIN_KEY / 2}, {0, 0}, {MAX_KEY, MAX_KEY / 2}};
+    ASSERT_EQ(sl->entries(), expected);
+    matches_element(sl->find(MIN_KEY), MIN_KEY / 2);
+    matches_element(sl->find(MAX_KEY), MAX_KEY / 2);
+    ASSERT_FALSE(sl->find(MAX_KEY - 1).has_value());
+
+    std::optional<Element> removed = sl->remove(MAX_KEY);
+    matches_element(removed, MAX_KEY / 2);
+    removed = sl->remove(MIN_KEY);
+    matches_element(removed, MIN_KEY / 2);
+    ASSERT_FALSE(sl->find(MAX_KEY).has_value());
+    ASSERT_FALSE(sl->find(MIN_KEY).has_value());
+    const std::vector<SkipList::Entry> rest{{0, 0}};
+    ASSERT_EQ(sl->entries(), rest);
+    std::filesystem::remove(path);
+}
+
+TEST(PersistentSkipListTest, ForeignFileIsLeftUntouched) {
+    const auto path = std::filesystem::temp_directory_path() / "skip_list_persistent_foreign.map";
+    const std::string contents(2 * 4096, 'x');
+    {
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        file << contents;
+    }
+
+    ASSERT_EQ(PersistentSkipList::open(path, 1 << 20), nullptr);
+    std::ifstream file(path, std::ios::binary);
+    const std::string after((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    ASSERT_EQ(after, contents);
+    std::filesystem::remove(path);
+}
+
+/////////////////////////////
+/// WRITE-AHEAD LOG TESTS ///
+/////////////////////////////
+
+TEST(WriteAheadLogTest, ReplayAfterReopen) {
+    const int num_entries = 100;
+    const auto path = std::filesystem::temp_directory_path() / "skip_list_wal_test.log";
+    std::filesystem::remove(path);
+
+    {
+        auto sl = DurableSkipList::open(path);
+        ASSERT_NE(sl, nullptr);
+        for (Key key = 0; key < num_entries; ++key) {
+            ASSERT_TRUE(sl->insert(key, key * 10));
+        }
+        ASSERT_FALSE(sl->insert(0, 0));
+        for (Key key = 0; key < num_entries; key += 2) {
+            std::optional<Element> element = sl->remove(key);
+            matches_element(element, key * 10);
+        }
+        ASSERT_FALSE(sl->remove(0).has_value());
+        ASSERT_EQ(sl->log().durableRecords(), num_entries + num_entries / 2);
+    }
+
+    {
+        // a torn record at the end of the log is dropped
+        std::ofstream file(path, std::ios::binary | std::ios::app);
+        file << "torn";
+    }
+
+    auto sl = DurableSkipList::open(path);
+    ASSERT_NE(sl, nullptr);
+    for (Key key = 0; key < num_entries; ++key) {
+        if (key % 2 == 0) {
+            ASSERT_FALSE(sl->find(key).has_value());
+        } else {
+            matches_element(sl->find(key), key * 10);
+        }
+    }
+    ASSERT_TRUE(sl->insert(0, 1));
+    ASSERT_EQ(sl->log().durableRecords(), num_entries + num_entries / 2 + 1);
+    std::filesystem::remove(path);
+}
+
+TEST(WriteAheadLogTest, GroupCommit) {
+    const int num_entries = 4000;
+    const int num_threads = 8;
+    const auto path = std::filesystem::temp_directory_path() / "skip_list_wal_group_test.log";
+    std::filesystem::remove(path);
+
+    {
+        auto sl = DurableSkipList::open(path, std::chrono::microseconds(100));
+        ASSERT_NE(sl, nullptr);
+
+        std::vector<std::thread> threads{};
+        for (int id = 0; id < num_threads; ++id) {
+            threads.emplace_back([&, id] {
+                for (Key key = id; key < num_entries; key += num_threads) {
+                    sl->insert(key, key);
+                }
+            });
+        }
+        for (auto &thread : threads) {
+            thread.join();
+        }
+        ASSERT_EQ(sl->log().durableRecords(), num_entries);
+        // threads share syncs
+        ASSERT_LT(sl->log().syncs(), num_entries);
+    }
+
+    auto sl = DurableSkipList::open(path);
+    ASSERT_NE(sl, nullptr);
+    for (Key key = 0; key < num_entries; ++key) {
+        matches_element(sl->find(key), key);
+    }
+    std::filesystem::remove(path);
+}
+
+TEST(WriteAheadLogTest, ChangesAreVisibleOnceDurable) {
+    const auto path = std::filesystem::temp_directory_path() / "skip_list_wal_visible_test.log";
+    std::filesystem::remove(path);
+
+    // the commit group of the insert is only written when the batch window is over
+    auto sl = DurableSkipList::open(path, std::chrono::milliseconds(300));
+    ASSERT_NE(sl, nullptr);
+    std::thread writer([&] {
+        ASSERT_TRUE(sl->insert(1, 10));
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    ASSERT_EQ(sl->log().durableRecords(), 0u);
+    ASSERT_FALSE(sl->find(1).has_value());
+    writer.join();
+    ASSERT_EQ(sl->log().durableRecords(), 1u);
+    matches_element(sl->find(1), 10);
+
+    std::thread remover([&] {
+        std::optional<Element> element = sl->remove(1);
+        matches_element(element, 10);
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    matches_element(sl->find(1), 10);
+    remover.join();
+    ASSERT_FALSE(sl->find(1).has_value());
+    std::filesystem::remove(path);
+}
+
+TEST(WriteAheadLogTest, ConflictingOperationsReplayInOrder) {
+    const int num_keys = 4;
+    const int num_threads = 4;
+    const int operations = 1000;
+    const auto path = std::filesystem::temp_directory_path() / "skip_list_wal_conflict_test.log";
+    std::filesystem::remove(path);
+
+    std::vector<SkipList::Entry> expected{};
+    {
+        auto sl = DurableSkipList::open(path);
+        ASSERT_NE(sl, nullptr);
+
+        // all threads insert and remove the same keys, so the log has to keep the order of the list
+        std::vector<std::thread> threads{};
+        for (int id = 0; id < num_threads; ++id) {
+            threads.emplace_back([&, id] {
+                std::mt19937 generator(id);
+                std::uniform_int_distribution<Key> keys(0, num_keys - 1);
+                for (int i = 0; i < operations; ++i) {
+                    Key key = keys(generator);
+                    if (i % 2 == 0) {
+                        sl->insert(key, id);
+                    } else {
+                        sl->remove(key);
+                    }
+                }
+            });
+        }
+        for (auto &thread : threads) {
+            thread.join();
+        }
+        expected.assign(sl->list().begin(), sl->list().end());
+    }
+
+    auto sl = DurableSkipList::open(path);
+    ASSERT_NE(sl, nullptr);
+    const std::vector<SkipList::Entry> replayed(sl->list().begin(), sl->list().end());
+    ASSERT_EQ(replayed, expected);
+    std::filesystem::remove(path);
+}
+
+////////////////////////////////
+/// UNROLLED SKIP LIST TESTS ///
+////////////////////////////////
+
+TEST(UnrolledSkipListTest, InsertFindRemoveScan) {
+    const int num_entries = 1000;
+    UnrolledSkipList sl{};
+
+    std::mt19937 shuffle_rng{42};
+    std::vector<Key> keys(num_entries);
+    std::iota(keys.begin(), keys.end(), 0);
+    std::shuffle(keys.begin(), keys.end(), shuffle_rng);
+
+    for (Key key : keys) {
+        ASSERT_TRUE(sl.insert(key, key * 10));
+    }
+    ASSERT_FALSE(sl.insert(keys[0], 0));
+    ASSERT_GT(sl.chunkCount(), num_entries / UnrolledSkipList::CHUNK_CAPACITY);
+
+    for (Key key = 0; key < num_entries; ++key) {
+        matches_element(sl.find(key), key * 10);
+    }
+    for (Key key = 0; key < num_entries; key += 2) {
+        std::optional<Element> element = sl.remove(key);
+        matches_element(element, key * 10);
+    }
+    ASSERT_FALSE(sl.remove(0).has_value());
+    ASSERT_FALSE(sl.find(num_entries).has_value());
+
+    std::vector<SkipList::Entry> expected{};
+    for (Key key = 101; key <= 301; key += 2) {
+        expected.emplace_back(key, key * 10);
+    }
+    std::vector<SkipList::Entry> result{};
+    sl.scanTo(100, 301, [&](const SkipList::Entry &entry) {
+        result.push_back(entry);
+        return true;
+    });
+    ASSERT_EQ(result, expected);
+}
+
+TEST(UnrolledSkipListTest, ConcurrentInsertAndRemove) {
+    const int num_entries = 20000;
+    const int num_threads = 4;
+    UnrolledSkipList sl{};
+
+    std::vector<std::thread> threads{};
+    for (int id = 0; id < num_threads; ++id) {
+        threads.emplace_back([&, id] {
+            for (Key key = id; key < num_entries; key += num_threads) {
+                sl.insert(key, key);
+                if (key % 3 == 0) {
+                    sl.remove(key);
+                }
+            }
+        });
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+
+    for (Key key = 0; key < num_entries; ++key) {
+        if (key % 3 == 0) {
+            ASSERT_FALSE(sl.find(key).has_value());
+        } else {
+            matches_element(sl.find(key), key);
+        }
+    }
+
+    Key previous = -1;
+    size_t count = sl.scanTo(MIN_KEY, MAX_KEY, [&](const SkipList::Entry &entry) {
+        EXPECT_GT(entry.first, previous);
+        previous = entry.first;
+        return true;
+    });
+    ASSERT_EQ(count, static_cast<size_t>(num_entries - (num_entries + 2) / 3));
+}
+
+////////////////////////
+/// WIDE INDEX TESTS ///
+////////////////////////
+
+TEST(WideIndexTest, FindWithEveryIsa) {
+    for (auto isa : {WideIndex::Isa::Scalar, WideIndex::Isa::Avx2, WideIndex::Isa::Avx512}) {
+        if (!WideIndex::supported(isa)) {
+            continue;
+        }
+        // sizes around full nodes and full levels
+        for (Key num_entries : {0, 1, 7, 8, 9, 64, 65, 1000}) {
+            std::vector<SkipList::Entry> entries{};
+            for (Key key = 0; key < num_entries; ++key) {
+                entries.emplace_back(key * 2 - 100, key);
+            }
+
+            WideIndex index{entries, isa};
+            ASSERT_EQ(index.size(), static_cast<size_t>(num_entries));
+            for (Key key = 0; key < num_entries; ++key) {
+                matches_element(index.find(key * 2 - 100), key) << WideIndex::name(isa);
+                ASSERT_FALSE(index.find(key * 2 - 99).has_value()) << WideIndex::name(isa);
+            }
+            ASSERT_FALSE(index.find(MIN_KEY + 1).has_value());
+            ASSERT_FALSE(index.find(-101).has_value());
+            ASSERT_FALSE(index.find(MAX_KEY - 1).has_value());
+        }
+    }
+}
+
+TEST(WideIndexTest, FrozenSkipList) {
+    const int num_entries = 5000;
+    SkipList sl{};
+    for (Key key = 0; key < num_entries; ++key) {
+        ASSERT_TRUE(sl.insert(key * 3, key));
+    }
+    for (Key key = 0; key < num_entries; key += 4) {
+        ASSERT_TRUE(sl.remove(key * 3).has_value());
+    }
+
+    ASSERT_FALSE(sl.buildWideIndex()) << "Only frozen lists can be indexed.";
+    sl.freeze();
+    ASSERT_TRUE(sl.buildWideIndex());
+    ASSERT_TRUE(sl.buildWideIndex());
+
+    for (Key key = 0; key < num_entries; ++key) {
+        if (key % 4 == 0) {
+            ASSERT_FALSE(sl.find(key * 3).has_value());
+        } else {
+            matches_element(sl.find(key * 3), key);
+        }
+        ASSERT_FALSE(sl.find(key * 3 + 1).has_value());
+    }
+}
+
+////////////////////
+/// EXPIRY TESTS ///
+////////////////////
+
+TEST(ExpiryTest, ExpiredEntriesAreAbsent) {
+    using namespace std::chrono_literals;
+    SkipList sl{};
+    ASSERT_TRUE(sl.insert(1, 10, 20ms));
+    ASSERT_TRUE(sl.insert(2, 20, 1h));
+    ASSERT_TRUE(sl.insert(3, 30, 20ms));
+    ASSERT_TRUE(sl.insert(4, 40));
+    matches_element(sl.find(1), 10);
+
+    std::this_thread::sleep_for(50ms);
+    ASSERT_FALSE(sl.find(1).has_value());
+    ASSERT_FALSE(sl.remove(3).has_value());
+    matches_element(sl.find(2), 20);
+    matches_element(sl.find(4), 40);
+
+    // the searches unlinked the expired entries
+    ASSERT_EQ(std::distance(sl.begin(), sl.end()), 2);
+    ASSERT_TRUE(sl.insert(1, 11));
+    matches_element(sl.find(1), 11);
+    ASSERT_EQ(sl.removeExpired(), 0u);
+}
+
+TEST(ExpiryTest, SweepExpired) {
+    using namespace std::chrono_literals;
+    const int num_entries = 1000;
+    SkipList sl{};
+
+    std::vector<std::thread> threads{};
+    for (int id = 0; id < 4; ++id) {
+        threads.emplace_back([&, id] {
+            for (Key key = id; key < num_entries; key += 4) {
+                // odd keys live long, even keys expire after all inserts are done
+                ASSERT_TRUE(sl.insert(key, key, key % 2 == 0 ? 200ms : 1h));
+            }
+        });
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+
+    std::this_thread::sleep_for(250ms);
+    ASSERT_EQ(sl.removeExpired(), static_cast<size_t>(num_entries / 2));
+    ASSERT_EQ(sl.removeExpired(), 0u);
+    ASSERT_EQ(std::distance(sl.begin(), sl.end()), num_entries / 2);
+    for (Key key = 1; key < num_entries; key += 2) {
+        matches_element(sl.find(key), key);
+    }
+}
+
+TEST(ExpiryTest, FrozenListHidesExpiredEntries) {
+    using namespace std::chrono_literals;
+    const auto filePath = std::filesystem::temp_directory_path() / "skip_list_expiry_test.sst";
+    const auto snapshotPath = std::filesystem::temp_directory_path() / "skip_list_expiry_test.bin";
+    SkipList sl{};
+    ASSERT_TRUE(sl.insert(1, 10));
+    ASSERT_TRUE(sl.insert(2, 20, 20ms));
+    ASSERT_TRUE(sl.insert(3, 30, 20ms));
+    ASSERT_TRUE(sl.insert(4, 40, 1h));
+
+    // a frozen list does not unlink the expired entries, so every reader has to skip them
+    sl.freeze();
+    std::this_thread::sleep_for(50ms);
+    ASSERT_FALSE(sl.buildWideIndex()) << "The index does not know deadlines.";
+    ASSERT_FALSE(sl.find(3).has_value());
+    ASSERT_EQ(sl.findFloor(3), std::optional<SkipList::Entry>({1, 10}));
+    ASSERT_EQ(sl.findFloor(4), std::optional<SkipList::Entry>({4, 40}));
+
+    ASSERT_TRUE(sl.flush(filePath));
+    SortedFileReader reader{};
+    ASSERT_TRUE(reader.open(filePath));
+    ASSERT_EQ(reader.size(), 2u);
+    ASSERT_FALSE(reader.find(2).has_value());
+
+    ASSERT_TRUE(sl.save(snapshotPath));
+    SkipList loaded{};
+    ASSERT_TRUE(loaded.load(snapshotPath));
+    const std::vector<SkipList::Entry> expected{{1, 10}, {4, 40}};
+    matches_array(loaded, expected);
+    std::filesystem::remove(filePath);
+    std::filesystem::remove(snapshotPath);
+}
+
+//////////////////////
+/// EVICTION TESTS ///
+//////////////////////
+
+TEST(EvictionTest, SmallestKey) {
+    const int capacity = 100;
+    SkipList sl{{.capacity = capacity, .eviction = EvictionPolicy::SmallestKey}};
+
+    for (Key key = 0; key < 1000; ++key) {
+        ASSERT_TRUE(sl.insert(key, key));
+        ASSERT_LE(sl.size(), static_cast<size_t>(capacity));
+    }
+    ASSERT_EQ(std::distance(sl.begin(), sl.end()), capacity);
+    ASSERT_EQ(sl.begin()->first, 1000 - capacity);
+    ASSERT_FALSE(sl.find(0).has_value());
+    matches_element(sl.find(999), 999);
+
+    std::optional<Element> removed = sl.remove(999);
+    matches_element(removed, 999);
+    ASSERT_EQ(sl.size(), static_cast<size_t>(capacity - 1));
+}
+
+TEST(EvictionTest, SampledLru) {
+    using namespace std::chrono_literals;
+    const int capacity = 200;
+    SkipList sl{{.capacity = capacity, .eviction = EvictionPolicy::SampledLru}};
+
+    for (Key key = 0; key < capacity; ++key) {
+        ASSERT_TRUE(sl.insert(key, key));
+    }
+    // make the first half recently used
+    std::this_thread::sleep_for(5ms);
+    for (Key key = 0; key < capacity / 2; ++key) {
+        matches_element(sl.find(key), key);
+    }
+    std::this_thread::sleep_for(5ms);
+
+    for (Key key = capacity; key < capacity + capacity / 4; ++key) {
+        ASSERT_TRUE(sl.insert(key, key));
+    }
+    ASSERT_EQ(sl.size(), static_cast<size_t>(capacity));
+    ASSERT_EQ(std::distance(sl.begin(), sl.end()), capacity);
+
+    // sampling mostly evicts entries of the cold half
+    int hot = 0;
+    for (Key key = 0; key < capacity / 2; ++key) {
+        hot += sl.find(key).has_value();
+    }
+    ASSERT_GE(hot, capacity / 2 * 9 / 10);
+}
+
+TEST(EvictionTest, ConcurrentInserts) {
+    const int capacity = 500;
+    const int num_threads = 4;
+    SkipList sl{{.capacity = capacity}};
+
+    std::vector<std::thread> threads{};
+    for (int id = 0; id < num_threads; ++id) {
+        threads.emplace_back([&, id] {
+            for (Key key = id; key < 20000; key += num_threads) {
+                sl.insert(key, key);
+            }
+        });
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+
+    auto entries = std::distance(sl.begin(), sl.end());
+    ASSERT_EQ(sl.size(), static_cast<size_t>(entries));
+    ASSERT_LE(entries, capacity + num_threads);
+}
+
+TEST(EvictionTest, LoadAndMergeRespectCapacity) {
+    const int capacity = 100;
+    const auto path = std::filesystem::temp_directory_path() / "skip_list_eviction_snapshot.bin";
+    SkipList full{};
+    for (Key key = 0; key < 1000; ++key) {
+        ASSERT_TRUE(full.insert(key, key));
+    }
+    ASSERT_TRUE(full.save(path));
+
+    SkipList loaded{{.capacity = capacity, .eviction = EvictionPolicy::SmallestKey}};
+    ASSERT_TRUE(loaded.load(path));
+    ASSERT_EQ(loaded.size(), static_cast<size_t>(capacity));
+    ASSERT_EQ(std::distance(loaded.begin(), loaded.end()), capacity);
+    ASSERT_EQ(loaded.begin()->first, 1000 - capacity);
+
+    SkipList merged{{.capacity = capacity, .eviction = EvictionPolicy::SmallestKey}};
+    ASSERT_TRUE(merged.insert(-1, -1));
+    ASSERT_TRUE(merged.merge(std::move(full)));
+    ASSERT_EQ(merged.size(), static_cast<size_t>(capacity));
+    ASSERT_EQ(std::distance(merged.begin(), merged.end()), capacity);
+    ASSERT_EQ(merged.begin()->first, 1000 - capacity);
+    std::filesystem::remove(path);
+}
+
+//////////////////////
+/// MULTIMAP TESTS ///
+//////////////////////
+
+TEST(MultimapTest, EqualRangeAndRemove) {
+    SkipList sl{{.allowDuplicates = true}};
+    ASSERT_TRUE(sl.insert(5, 1));
+    ASSERT_TRUE(sl.insert(4, 0));
+    ASSERT_TRUE(sl.insert(5, 2));
+    ASSERT_TRUE(sl.insert(6, 0));
+    ASSERT_TRUE(sl.insert(5, 3));
+    ASSERT_EQ(sl.size(), 5u);
+
+    auto elements = [&](Key key) {
+        std::vector<Element> result{};
+        auto [first, last] = sl.equal_range(key);
+        for (auto it = first; it != last; ++it) {
+            result.push_back(it->second);
+        }
+        return result;
+    };
+    ASSERT_EQ(elements(5), (std::vector<Element>{1, 2, 3}));
+    ASSERT_EQ(elements(7), std::vector<Element>{});
+    matches_element(sl.find(5), 3);
+
+    std::optional<Element> oldest = sl.remove(5);
+    matches_element(oldest, 1);
+    ASSERT_EQ(elements(5), (std::vector<Element>{2, 3}));
+
+    ASSERT_EQ(sl.removeAll(5), 2u);
+    ASSERT_FALSE(sl.find(5).has_value());
+    ASSERT_EQ(sl.removeAll(5), 0u);
+    ASSERT_EQ(sl.size(), 2u);
+    ASSERT_EQ(elements(4), std::vector<Element>{0});
+
+    SkipList unique{};
+    ASSERT_TRUE(unique.insert(5, 1));
+    ASSERT_FALSE(unique.insert(5, 2));
+    ASSERT_EQ(unique.removeAll(5), 1u);
+}
+
+TEST(MultimapTest, ConcurrentInsertAndRemove) {
+    const int num_keys = 100;
+    const int num_threads = 4;
+    const int duplicates = 50;
+    SkipList sl{{.allowDuplicates = true}};
+
+    std::vector<std::thread> threads{};
+    for (int id = 0; id < num_threads; ++id) {
+        threads.emplace_back([&, id] {
+            for (int i = 0; i < duplicates; ++i) {
+                for (Key key = 0; key < num_keys; ++key) {
+                    ASSERT_TRUE(sl.insert(key, id));
+                }
+            }
+        });
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+    ASSERT_EQ(sl.size(), static_cast<size_t>(num_keys * num_threads * duplicates));
+
+    // every thread removes half of the entries of every key
+    std::atomic<size_t> removed = 0;
+    threads.clear();
+    for (int id = 0; id < num_threads; ++id) {
+        threads.emplace_back([&] {
+            for (int i = 0; i < duplicates / 2; ++i) {
+                for (Key key = 0; key < num_keys; ++key) {
+                    removed += sl.remove(key).has_value();
+                }
+            }
+        });
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+
+    ASSERT_EQ(removed, static_cast<size_t>(num_keys * num_threads * duplicates / 2));
+    for (Key key = 0; key < num_keys; ++key) {
+        auto [first, last] = sl.equal_range(key);
+        ASSERT_EQ(std::distance(first, last), num_threads * duplicates / 2);
+    }
+}
+
+TEST(MultimapTest, SaveAndLoad) {
+    const auto path = std::filesystem::temp_directory_path() / "skip_list_multimap_snapshot.bin";
+    SkipList sl{{.allowDuplicates = true}};
+    std::vector<SkipList::Entry> expected{};
+    for (Key key = 0; key < 3000; ++key) {
+        // runs of equal keys also cross the block boundaries of the snapshot
+        ASSERT_TRUE(sl.insert(key / 7, key));
+        expected.emplace_back(key / 7, key);
+    }
+    ASSERT_TRUE(sl.save(path));
+
+    SkipList loaded{{.allowDuplicates = true}};
+    ASSERT_TRUE(loaded.load(path));
+    matches_array(loaded, expected);
+    std::optional<Element> oldest = loaded.remove(1);
+    matches_element(oldest, 7);
+
+    SkipList unique{};
+    ASSERT_FALSE(unique.load(path)) << "A list without duplicates cannot hold the snapshot.";
+
+    sl.freeze();
+    ASSERT_FALSE(sl.flush(path)) << "A sorted file holds every key once.";
+    std::filesystem::remove(path);
+}
+
+/////////////////////////////////
+/// VARIABLE-SIZE VALUE TESTS ///
+/////////////////////////////////
+
+TEST(VariableSizeValueTest, InsertFindRemove) {
+    SkipList sl{{.variableSizeValues = true}};
+    const std::string large(ValueArena::CHUNK_SIZE, 'x');
+
+    ASSERT_TRUE(sl.insertValue(1, "one"));
+    ASSERT_TRUE(sl.insertValue(2, ""));
+    ASSERT_TRUE(sl.insertValue(3, large));
+    ASSERT_FALSE(sl.insertValue(1, "uno"));
+    ASSERT_FALSE(sl.insert(4, 4)) << "Elements cannot be mixed with values.";
+
+    std::optional<std::string_view> one = sl.findValue(1);
+    matches_element(one, "one");
+    matches_element(sl.findValue(2), "");
+    matches_element(sl.findValue(3), large);
+    ASSERT_FALSE(sl.findValue(4).has_value());
+
+    // elements are arena addresses, so the functions that return them reject the list
+    std::array<SkipList::Entry, 4> entries{};
+    std::array<iovec, 4> iovecs{};
+    ASSERT_FALSE(sl.find(1).has_value());
+    ASSERT_FALSE(sl.findFloor(1).has_value());
+    ASSERT_FALSE(sl.remove(1).has_value());
+    ASSERT_FALSE(sl.handle().find(1).has_value());
+    ASSERT_EQ(sl.scanInto(MIN_KEY, MAX_KEY, entries), 0u);
+    ASSERT_EQ(sl.scanIovec(MIN_KEY, MAX_KEY, iovecs), 0u);
+    ASSERT_EQ(sl.aggregate(MIN_KEY, MAX_KEY).count, 0u);
+    ASSERT_EQ(ValueArena::view(sl.begin()->second), "one");
+
+    std::optional<std::string_view> removed = sl.removeValue(1);
+    matches_element(removed, "one");
+    ASSERT_FALSE(sl.findValue(1).has_value());
+    // views stay valid after the entry was removed
+    ASSERT_EQ(*one, "one");
+
+    SkipList elements{};
+    ASSERT_FALSE(elements.insertValue(1, "one"));
+}
+
+TEST(VariableSizeValueTest, ConcurrentInserts) {
+    const int num_threads = 4;
+    const int num_entries = 20000;
+    SkipList sl{{.variableSizeValues = true}};
+
+    std::vector<std::thread> threads{};
+    for (int id = 0; id < num_threads; ++id) {
+        threads.emplace_back([&, id] {
+            for (Key key = id; key < num_entries; key += num_threads) {
+                // sizes up to a few hundred bytes fill several chunks
+                ASSERT_TRUE(sl.insertValue(key, std::string(key % 300, static_cast<char>('a' + key % 26))));
+            }
+        });
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+
+    for (Key key = 0; key < num_entries; ++key) {
+        matches_element(sl.findValue(key), std::string(key % 300, static_cast<char>('a' + key % 26)));
+    }
+}
+
+///////////////////////
+/// AGGREGATE TESTS ///
+///////////////////////
+
+// brute force aggregate of the entries of a map, compared against SkipList::aggregate()
+static void expect_aggregate(SkipList &sl, const std::multimap<Key, Element> &entries, Key lo, Key hi) {
+    RangeAggregate expected{};
+    for (auto it = entries.lower_bound(lo); it != entries.end() && it->first <= hi; ++it) {
+        expected.add(it->second);
+    }
+    RangeAggregate actual = sl.aggregate(lo, hi);
+    ASSERT_EQ(actual.count, expected.count) << lo << " " << hi;
+    ASSERT_EQ(actual.sum, expected.sum) << lo << " " << hi;
+    if (expected.count > 0) {
+        ASSERT_EQ(actual.min, expected.min) << lo << " " << hi;
+        ASSERT_EQ(actual.max, expected.max) << lo << " " << hi;
+    }
+}
+
+TEST(AggregateTest, MatchesScanAfterUpdates) {
+    const int num_keys = 5000;
+    std::mt19937_64 generator{42};
+    std::uniform_int_distribution<Element> elements(-1000, 1000);
+    std::uniform_int_distribution<Key> keys(-10, num_keys * 2 + 10);
+
+    SkipList sl{{.augmented = true}};
+    SkipList plain{};
+    std::multimap<Key, Element> entries{};
+    expect_aggregate(sl, entries, MIN_KEY, MAX_KEY);
+    for (Key key = 0; key < num_keys * 2; key += 2) {
+        Element element = elements(generator);
+        ASSERT_TRUE(sl.insert(key, element));
+        ASSERT_TRUE(plain.insert(key, element));
+        entries.emplace(key, element);
+    }
+
+    for (int round = 0; round < 3; ++round) {
+        expect_aggregate(sl, entries, MIN_KEY, MAX_KEY);
+        for (int i = 0; i < 200; ++i) {
+            Key lo = keys(generator);
+            Key hi = lo + keys(generator) / 4;
+            expect_aggregate(sl, entries, lo, hi);
+            // the same query again is answered from the caches
+            expect_aggregate(sl, entries, lo, hi);
+            if (round == 0) {
+                expect_aggregate(plain, entries, lo, hi);
+            }
+        }
+        // every update invalidates the spans around its key
+        for (int i = 0; i < 500; ++i) {
+            Key key = keys(generator);
+            if (sl.remove(key).has_value()) {
+                entries.erase(key);
+            } else if (Element element = elements(generator); sl.insert(key, element)) {
+                entries.emplace(key, element);
+            }
+        }
+    }
+    ASSERT_EQ(sl.aggregate(5, 4).count, 0u);
+}
+
+TEST(AggregateTest, DuplicateKeys) {
+    SkipList sl{{.allowDuplicates = true, .augmented = true}};
+    std::multimap<Key, Element> entries{};
+    for (int i = 0; i < 2000; ++i) {
+        Key key = i % 50;
+        ASSERT_TRUE(sl.insert(key, i));
+        entries.emplace(key, i);
+    }
+    for (Key lo = -1; lo <= 50; lo += 3) {
+        expect_aggregate(sl, entries, lo, lo);
+        expect_aggregate(sl, entries, lo, lo + 7);
+    }
+    ASSERT_EQ(sl.removeAll(10), 40u);
+    entries.erase(10);
+    expect_aggregate(sl, entries, 5, 15);
+    expect_aggregate(sl, entries, MIN_KEY, MAX_KEY);
+}
+
+TEST(AggregateTest, ExactOnceQuiescent) {
+    const int num_keys = 4000;
+    const int num_threads = 4;
+    SkipList sl{{.augmented = true}};
+
+    std::atomic<bool> done = false;
+    std::thread reader([&] {
+        while (!done) {
+            // concurrent queries fill caches that the updates have to invalidate
+            RangeAggregate all = sl.aggregate(MIN_KEY, MAX_KEY);
+            ASSERT_LE(all.count, static_cast<uint64_t>(num_keys));
+            sl.aggregate(num_keys / 4, num_keys / 2);
+        }
+    });
+    std::vector<std::thread> threads{};
+    for (int id = 0; id < num_threads; ++id) {
+        threads.emplace_back([&, id] {
+            // every thread inserts its keys and removes every other one again
+            for (Key key = id; key < num_keys; key += num_threads) {
+                ASSERT_TRUE(sl.insert(key, key));
+            }
+            for (Key key = id; key < num_keys; key += 2 * num_threads) {
+                ASSERT_TRUE(sl.remove(key).has_value());
+            }
+        });
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+    done = true;
+    reader.join();
+
+    std::multimap<Key, Element> entries{};
+    for (const auto &[key, element] : sl) {
+        entries.emplace(key, element);
+    }
+    ASSERT_EQ(entries.size(), static_cast<size_t>(num_keys / 2));
+    expect_aggregate(sl, entries, MIN_KEY, MAX_KEY);
+    for (Key lo = 0; lo < num_keys; lo += 97) {
+        expect_aggregate(sl, entries, lo, lo + 613);
+    }
+}
+
+/////////////////////////
+/// TRANSACTION TESTS ///
+/////////////////////////
+
+TEST(TransactionTest, MoveAndAllOrNothing) {
+    SkipList sl{{.transactional = true}};
+    ASSERT_TRUE(sl.insert(1, 10));
+    ASSERT_TRUE(sl.insert(2, 20));
+
+    // move the element of key 1 to key 3
+    Transaction move(sl);
+    std::optional<Element> element = move.find(1);
+    matches_element(element, 10);
+    move.remove(1);
+    move.insert(3, *element);
+    ASSERT_FALSE(move.find(1).has_value());
+    ASSERT_TRUE(move.commit());
+    ASSERT_FALSE(move.commit());
+    ASSERT_FALSE(sl.find(1).has_value());
+    matches_element(sl.find(3), 10);
+    ASSERT_EQ(sl.size(), 2u);
+
+    // key 2 exists, so none of the keys is inserted
+    Transaction batch(sl);
+    for (Key key : {4, 2, 5}) {
+        batch.insert(key, key);
+    }
+    ASSERT_FALSE(batch.commit());
+    ASSERT_FALSE(sl.find(4).has_value());
+    ASSERT_FALSE(sl.find(5).has_value());
+    matches_element(sl.find(2), 20);
+
+    Transaction update(sl);
+    update.update(2, 21);
+    update.update(3, 11);
+    ASSERT_TRUE(update.commit());
+    matches_element(sl.find(2), 21);
+    matches_element(sl.find(3), 11);
+
+    // a read key that changed before the commit aborts the transaction
+    Transaction stale(sl);
+    matches_element(stale.find(2), 21);
+    stale.insert(6, 6);
+    ASSERT_TRUE(sl.remove(2).has_value());
+    ASSERT_FALSE(stale.commit());
+    ASSERT_FALSE(sl.find(6).has_value());
+
+    Transaction contradiction(sl);
+    contradiction.remove(3);
+    contradiction.remove(3);
+    ASSERT_FALSE(contradiction.commit());
+    ASSERT_TRUE(sl.find(3).has_value());
+
+    SkipList plain{};
+    ASSERT_TRUE(plain.insert(1, 1));
+    Transaction unsupported(plain);
+    unsupported.remove(1);
+    ASSERT_FALSE(unsupported.commit());
+}
+
+TEST(TransactionTest, FrozenListRejectsCommit) {
+    SkipList sl{{.transactional = true}};
+    ASSERT_TRUE(sl.insert(1, 10));
+    Transaction transaction(sl);
+    transaction.remove(1);
+    transaction.insert(2, 20);
+    sl.freeze();
+    ASSERT_FALSE(transaction.commit());
+    matches_element(sl.find(1), 10);
+    ASSERT_FALSE(sl.find(2).has_value());
+
+    // freeze() waits for commits, so every transfer is applied completely or not at all
+    const int num_accounts = 16;
+    const int num_threads = 4;
+    const Element balance = 100;
+    SkipList accounts{{.transactional = true}};
+    for (Key key = 0; key < num_accounts; ++key) {
+        ASSERT_TRUE(accounts.insert(key, balance));
+    }
+    std::vector<std::thread> threads{};
+    for (int id = 0; id < num_threads; ++id) {
+        threads.emplace_back([&, id] {
+            std::mt19937 generator(id);
+            std::uniform_int_distribution<Key> account(0, num_accounts - 1);
+            while (!accounts.isFrozen()) {
+                Key from = account(generator);
+                Key to = (from + 1) % num_accounts;
+                Transaction transfer(accounts);
+                Element source = *transfer.find(from);
+                Element target = *transfer.find(to);
+                transfer.update(from, source - 1);
+                transfer.update(to, target + 1);
+                transfer.commit();
+            }
+        });
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    accounts.freeze();
+    for (auto &thread : threads) {
+        thread.join();
+    }
+    Element total = 0;
+    for (Key key = 0; key < num_accounts; ++key) {
+        total += accounts.find(key).value();
+    }
+    ASSERT_EQ(total, balance * num_accounts);
+}
+
+TEST(TransactionTest, ConcurrentTransfersKeepTotal) {
+    const int num_accounts = 32;
+    const int num_threads = 4;
+    const int transfers = 2000;
+    const Element balance = 100;
+    SkipList sl{{.transactional = true}};
+    for (Key key = 0; key < num_accounts; ++key) {
+        ASSERT_TRUE(sl.insert(key, balance));
+    }
+
+    std::atomic<bool> done = false;
+    std::atomic<int> consistentReads = 0;
+    std::thread auditor([&] {
+        while (!done) {
+            Transaction audit(sl);
+            Element total = 0;
+            for (Key key = 0; key < num_accounts; ++key) {
+                total += audit.find(key).value_or(0);
+                // updates replace towers, but a find never sees an account missing
+                ASSERT_TRUE(sl.find(key).has_value());
+            }
+            if (audit.commit()) {
+                ASSERT_EQ(total, balance * num_accounts);
+                consistentReads++;
+            }
+        }
+    });
+
+    std::vector<std::thread> threads{};
+    for (int id = 0; id < num_threads; ++id) {
+        threads.emplace_back([&, id] {
+            std::mt19937 generator(id);
+            std::uniform_int_distribution<Key> accounts(0, num_accounts - 1);
+            for (int i = 0; i < transfers; ++i) {
+                Key from = accounts(generator);
+                Key to = (from + 1 + accounts(generator) % (num_accounts - 1)) % num_accounts;
+                while (true) {
+                    Transaction transfer(sl);
+                    Element source = *transfer.find(from);
+                    Element target = *transfer.find(to);
+                    transfer.update(from, source - 1);
+                    transfer.update(to, target + 1);
+                    if (transfer.commit()) {
+                        break;
+                    }
+                }
+            }
+        });
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+    done = true;
+    auditor.join();
+
+    Element total = 0;
+    for (const auto &[key, element] : sl) {
+        total += element;
+    }
+    ASSERT_EQ(total, balance * num_accounts);
+    ASSERT_EQ(sl.size(), static_cast<size_t>(num_accounts));
+    ASSERT_GT(consistentReads, 0);
+}
+
+/////////////////////////////
+/// MERGE AND SPLIT TESTS ///
+/////////////////////////////
+
+TEST(MergeSplitTest, MergeInterleaved) {
+    SkipList sl{};
+    SkipList other{};
+    for (Key key = 0; key < 1000; key += 2) {
+        ASSERT_TRUE(sl.insert(key, key));
+    }
+    // odd keys, runs behind the largest key and keys that are already in sl
+    for (Key key = 1; key < 1500; key += 2) {
+        ASSERT_TRUE(other.insert(key, key));
+    }
+    for (Key key = 0; key < 100; key += 10) {
+        ASSERT_TRUE(other.insert(key, -1));
+    }
+    ASSERT_TRUE(other.remove(501).has_value());
+    ASSERT_TRUE(sl.remove(500).has_value());
+
+    ASSERT_TRUE(sl.merge(std::move(other)));
+    ASSERT_EQ(other.size(), 0u);
+    ASSERT_EQ(other.begin(), other.end());
+    ASSERT_EQ(sl.size(), 500u - 1 + 750 - 1);
+
+    std::vector<Key> keys{};
+    for (const auto &[key, element] : sl) {
+        ASSERT_EQ(element, key); // the entries of sl were kept
+        keys.push_back(key);
+    }
+    ASSERT_TRUE(std::is_sorted(keys.begin(), keys.end()));
+    ASSERT_EQ(keys.size(), sl.size());
+    for (Key key = 0; key < 1500; ++key) {
+        bool expected = (key < 1000 || key % 2 == 1) && key != 500 && key != 501;
+        ASSERT_EQ(sl.find(key).has_value(), expected) << key;
+    }
+
+    // both lists stay usable
+    ASSERT_TRUE(sl.insert(500, 500));
+    ASSERT_TRUE(sl.remove(777).has_value());
+    ASSERT_TRUE(other.insert(3, 3));
+    matches_element(other.find(3), 3);
+
+    SkipList duplicates{{.allowDuplicates = true}};
+    ASSERT_FALSE(sl.merge(std::move(duplicates)));
+}
+
+TEST(MergeSplitTest, MergeDuplicateKeys) {
+    SkipList sl{{.allowDuplicates = true}};
+    SkipList other{{.allowDuplicates = true}};
+    ASSERT_TRUE(sl.insert(5, 1));
+    ASSERT_TRUE(sl.insert(5, 2));
+    ASSERT_TRUE(other.insert(5, 3));
+    ASSERT_TRUE(other.insert(4, 0));
+    ASSERT_TRUE(sl.merge(std::move(other)));
+
+    std::vector<Element> elements{};
+    auto [first, last] = sl.equal_range(5);
+    for (auto it = first; it != last; ++it) {
+        elements.push_back(it->second);
+    }
+    ASSERT_EQ(elements, (std::vector<Element>{1, 2, 3}));
+    ASSERT_EQ(sl.size(), 4u);
+}
+
+TEST(MergeSplitTest, SplitAndMergeBack) {
+    for (bool augmented : {false, true}) {
+        SkipList sl{{.augmented = augmented}};
+        for (Key key = 0; key < 1000; ++key) {
+            ASSERT_TRUE(sl.insert(key, key));
+        }
+        ASSERT_TRUE(sl.remove(600).has_value());
+        ASSERT_EQ(sl.aggregate(0, 999).count, 999u);
+
+        std::unique_ptr<SkipList> upper = sl.split_at(500);
+        ASSERT_NE(upper, nullptr);
+        ASSERT_EQ(sl.size(), 500u);
+        ASSERT_EQ(upper->size(), 499u);
+        ASSERT_EQ(sl.aggregate(0, 999).count, 500u);
+        ASSERT_EQ(upper->aggregate(0, 999).count, 499u);
+        ASSERT_EQ(sl.aggregate(0, 999).max, 499);
+        ASSERT_EQ(upper->aggregate(0, 999).min, 500);
+        ASSERT_EQ(std::distance(sl.begin(), sl.end()), 500);
+        ASSERT_EQ(std::distance(upper->begin(), upper->end()), 499);
+        ASSERT_FALSE(sl.find(500).has_value());
+        matches_element(upper->find(500), 500);
+        matches_element(sl.find(499), 499);
+
+        // both parts stay usable, also for keys of the other part
+        ASSERT_TRUE(sl.insert(2000, 2000));
+        ASSERT_TRUE(upper->insert(-5, -5));
+        ASSERT_TRUE(upper->remove(999).has_value());
+
+        std::unique_ptr<SkipList> empty = upper->split_at(5000);
+        ASSERT_EQ(empty->size(), 0u);
+        ASSERT_EQ(empty->begin(), empty->end());
+        std::unique_ptr<SkipList> all = upper->split_at(MIN_KEY);
+        ASSERT_EQ(upper->size(), 0u);
+        ASSERT_EQ(all->size(), 499u);
+
+        ASSERT_TRUE(sl.merge(std::move(*all)));
+        ASSERT_EQ(sl.size(), 1000u);
+        RangeAggregate total = sl.aggregate(MIN_KEY, MAX_KEY);
+        ASSERT_EQ(total.count, 1000u);
+        ASSERT_EQ(total.min, -5);
+        ASSERT_EQ(total.max, 2000);
+    }
+}
+
+/////////////////////////
+/// KEY COMPARE TESTS ///
+/////////////////////////
+
+TEST(KeyCompareTest, PackedKeys) {
+    using TenantKey = PackedKey<40>;
+    static_assert(TenantKey::pack(TenantKey::MAX_HIGH, TenantKey::MAX_LOW) == MAX_KEY);
+    ASSERT_TRUE(KeyCompare::less(TenantKey::pack(1, TenantKey::MAX_LOW), TenantKey::pack(2, 0)));
+    ASSERT_TRUE(KeyCompare::equal(TenantKey::pack(7, 9), TenantKey::pack(7, 9)));
+    ASSERT_EQ(TenantKey::high(TenantKey::pack(7, 9)), 7u);
+    ASSERT_EQ(TenantKey::low(TenantKey::pack(7, 9)), 9u);
+
+    SkipList sl{};
+    for (uint64_t tenant = 0; tenant < 8; ++tenant) {
+        for (uint64_t timestamp : {uint64_t(0), uint64_t(5), TenantKey::MAX_LOW}) {
+            ASSERT_TRUE(sl.insert(TenantKey::pack(tenant, timestamp), static_cast<Element>(tenant)));
+        }
+    }
+    // all entries of one tenant form one range, ordered by timestamp
+    std::vector<uint64_t> timestamps{};
+    sl.scanTo(TenantKey::pack(3, 0), TenantKey::pack(3, TenantKey::MAX_LOW), [&](const SkipList::Entry &entry) {
+        EXPECT_EQ(entry.second, 3);
+        timestamps.push_back(TenantKey::low(entry.first));
+        return true;
+    });
+    ASSERT_EQ(timestamps, (std::vector<uint64_t>{0, 5, TenantKey::MAX_LOW}));
+    std::optional<Element> removed = sl.remove(TenantKey::pack(3, 5));
+    matches_element(removed, 3);
+    ASSERT_FALSE(sl.find(TenantKey::pack(3, 5)).has_value());
+    ASSERT_EQ(sl.size(), 23u);
+}
+
+TEST(KeyCompareTest, KeyRangeBoundaries) {
+    const std::vector<Key> keys{MIN_KEY + 1, MIN_KEY + 2, -1, 0, 1, MAX_KEY - 2, MAX_KEY - 1};
+    SkipList sl{};
+    for (Key key : keys) {
+        ASSERT_TRUE(sl.insert(key, key));
+        ASSERT_FALSE(sl.insert(key, key));
+    }
+    auto scanned = [](SkipList &list, Key lo, Key hi) {
+        std::vector<Key> result{};
+        list.scanTo(lo, hi, [&](const SkipList::Entry &entry) {
+            result.push_back(entry.first);
+            return true;
+        });
+        return result;
+    };
+    ASSERT_EQ(scanned(sl, MIN_KEY, MAX_KEY), keys);
+    ASSERT_EQ(scanned(sl, MIN_KEY + 2, MAX_KEY - 2), std::vector<Key>(keys.begin() + 1, keys.end() - 1));
+    ASSERT_EQ(scanned(sl, MIN_KEY + 1, MIN_KEY + 1), std::vector<Key>{MIN_KEY + 1});
+    ASSERT_FALSE(sl.findFloor(MIN_KEY).has_value());
+    ASSERT_EQ(sl.findFloor(MIN_KEY + 1)->first, MIN_KEY + 1);
+    ASSERT_EQ(sl.findFloor(MAX_KEY - 1)->first, MAX_KEY - 1);
+    auto [first, last] = sl.equal_range(MIN_KEY + 1);
+    ASSERT_EQ(std::distance(first, last), 1);
+
+    std::optional<Element> removed = sl.remove(MIN_KEY + 1);
+    matches_element(removed, MIN_KEY + 1);
+    ASSERT_FALSE(sl.remove(MIN_KEY + 1).has_value());
+    removed = sl.remove(MAX_KEY - 1);
+    matches_element(removed, MAX_KEY - 1);
+    ASSERT_FALSE(sl.find(MAX_KEY - 1).has_value());
+    matches_element(sl.find(MAX_KEY - 2), MAX_KEY - 2);
+
+    // frozen lists position scans with the strict search that does not help
+    sl.freeze();
+    ASSERT_EQ(scanned(sl, MIN_KEY, MAX_KEY), std::vector<Key>(keys.begin() + 1, keys.end() - 1));
+    ASSERT_EQ(scanned(sl, MIN_KEY + 2, 0), (std::vector<Key>{MIN_KEY + 2, -1, 0}));
+
+    // the oldest entry of a duplicate key at the lower boundary is removed first
+    SkipList duplicates{{.allowDuplicates = true}};
+    ASSERT_TRUE(duplicates.insert(MIN_KEY + 1, 1));
+    ASSERT_TRUE(duplicates.insert(MIN_KEY + 1, 2));
+    removed = duplicates.remove(MIN_KEY + 1);
+    matches_element(removed, 1);
+    ASSERT_EQ(duplicates.removeAll(MIN_KEY + 1), 1u);
+
+    // sampling picks keys up to the largest key
+    SkipList bounded{{.capacity = 2, .eviction = EvictionPolicy::SampledLru}};
+    for (Key key : {MAX_KEY - 1, MIN_KEY + 1, Key(0)}) {
+        ASSERT_TRUE(bounded.insert(key, key));
+    }
+    ASSERT_EQ(bounded.size(), 2u);
+}
+
+TEST(KeyCompareTest, SentinelKeysAreValid) {
+    SkipList sl{};
+    ASSERT_FALSE(sl.find(MIN_KEY).has_value());
+    ASSERT_FALSE(sl.find(MAX_KEY).has_value());
+    ASSERT_FALSE(sl.findFloor(MAX_KEY).has_value());
+    ASSERT_FALSE(sl.remove(MAX_KEY).has_value());
+
+    for (Key key : {MAX_KEY, Key(0), MIN_KEY}) {
+        ASSERT_TRUE(sl.insert(key, key / 2));
+        ASSERT_FALSE(sl.insert(key, key / 2));
+    }
+    matches_element(sl.find(MIN_KEY), MIN_KEY / 2);
+    matches_element(sl.find(MAX_KEY), MAX_KEY / 2);
+    ASSERT_EQ(sl.findFloor(MIN_KEY)->first, MIN_KEY);
+    ASSERT_EQ(sl.findFloor(MAX_KEY)->first, MAX_KEY);
+    ASSERT_EQ(sl.findFloor(MAX_KEY - 1)->first, 0);
+    const std::vector<SkipList::Entry> expected{{MIN_KEY, MIN_KEY / 2}, {0, 0}, {MAX_KEY, MAX_KEY / 2}};
+    matches_array(sl, expected);
+    auto [first, last] = sl.equal_range(MAX_KEY);
+    ASSERT_EQ(std::distance(first, last), 1);
+    ASSERT_TRUE(last == sl.end());
+
+    // a snapshot keeps both keys, and the wide index of a frozen list finds them
+    const auto path = std::filesystem::temp_directory_path() / "skip_list_sentinel_keys.bin";
+    ASSERT_TRUE(sl.save(path));
+    SkipList loaded{};
+    ASSERT_TRUE(loaded.load(path));
+    std::filesystem::remove(path);
+    loaded.freeze();
+    ASSERT_TRUE(loaded.buildWideIndex());
+    matches_element(loaded.find(MAX_KEY), MAX_KEY / 2);
+    matches_element(loaded.find(MIN_KEY), MIN_KEY / 2);
+
+    std::optional<Element> removed = sl.remove(MAX_KEY);
+    matches_element(removed, MAX_KEY / 2);
+    removed = sl.remove(MIN_KEY);
+    matches_element(removed, MIN_KEY / 2);
+    ASSERT_FALSE(sl.find(MAX_KEY).has_value());
+    ASSERT_EQ(sl.size(), 1u);
+
+    // the tail stays behind entries with MAX_KEY when lists are merged
+    SkipList other{};
+    ASSERT_TRUE(other.insert(MAX_KEY, 1));
+    ASSERT_TRUE(other.insert(MIN_KEY, 2));
+    ASSERT_TRUE(sl.merge(std::move(other)));
+    const std::vector<SkipList::Entry> merged{{MIN_KEY, 2}, {0, 0}, {MAX_KEY, 1}};
+    matches_array(sl, merged);
+
+    SkipList duplicates{{.allowDuplicates = true, .augmented = true}};
+    for (Element element = 0; element < 3; ++element) {
+        ASSERT_TRUE(duplicates.insert(MAX_KEY, element));
+        ASSERT_TRUE(duplicates.insert(MIN_KEY, element));
+    }
+    ASSERT_EQ(duplicates.aggregate(MAX_KEY, MAX_KEY).count, 3u);
+    ASSERT_EQ(duplicates.aggregate(MIN_KEY, MAX_KEY).sum, 6);
+    ASSERT_EQ(duplicates.removeAll(MAX_KEY), 3u);
+    ASSERT_EQ(duplicates.aggregate(MIN_KEY, MAX_KEY).count, 3u);
+}
+
+//////////////////////////
+/// TOWER HEIGHT TESTS ///
+//////////////////////////
+
+TEST(TowerHeightTest, GeometricAcrossConcurrentInserters) {
+    const int num_threads = 64;
+    const int keys_per_thread = 1000;
+    SkipList sl{};
+    std::barrier start_threads{num_threads};
+    std::vector<std::thread> threads{};
+    for (int t = 0; t < num_threads; ++t) {
+        threads.emplace_back([&, t] {
+            start_threads.arrive_and_wait();
+            for (int i = 0; i < keys_per_thread; ++i) {
+                sl.insert(i * num_threads + t, t);
+            }
+        });
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+
+    // chi-square test of the number of towers of every height against p = 0.5, tall towers form one bucket
+    std::array<size_t, MAX_LEVEL> counts = sl.levelCounts();
+    const double n = num_threads * keys_per_thread;
+    ASSERT_EQ(counts[0], n);
+    const Level buckets = 14;
+    double chiSquare = 0;
+    for (Level v = 1; v <= buckets; ++v) {
+        double observed = v < buckets ? counts[v - 1] - counts[v] : counts[v - 1];
+        double expected = v < buckets ? n / std::pow(2.0, v) : n / std::pow(2.0, v - 1);
+        chiSquare += (observed - expected) * (observed - expected) / expected;
+    }
+    // 13 degrees of freedom, exceeded with probability < 1e-6; threads with equal streams fail by far
+    ASSERT_LT(chiSquare, 50.0);
+}
+
+TEST(TowerHeightTest, SeedReproducesHeights) {
+    SkipList first{{.seed = 42}};
+    SkipList second{{.seed = 42}};
+    SkipList other{{.seed = 43}};
+    for (Key key = 0; key < 10000; ++key) {
+        // alternating between lists keeps the stream of each one
+        ASSERT_TRUE(first.insert(key, key));
+        ASSERT_TRUE(second.insert(key, key));
+        ASSERT_TRUE(other.insert(key, key));
+    }
+    ASSERT_EQ(first.levelCounts(), second.levelCounts());
+    ASSERT_NE(first.levelCounts(), other.levelCounts());
+
+    // without a seed every list draws different heights
+    SkipList unseeded{};
+    SkipList unseededToo{};
+    for (Key key = 0; key < 10000; ++key) {
+        ASSERT_TRUE(unseeded.insert(key, key));
+        ASSERT_TRUE(unseededToo.insert(key, key));
+    }
+    ASSERT_NE(unseeded.levelCounts(), unseededToo.levelCounts());
+}
+
+TEST(TowerHeightTest, KeyHashShapeIsReproducible) {
+    const int num_entries = 20000;
+    const SkipListOptions options{.towerHeights = TowerHeights::KeyHash};
+    SkipList ascending{options};
+    for (Key key = 0; key < num_entries; ++key) {
+        ASSERT_TRUE(ascending.insert(key, key));
+    }
+    std::array<size_t, MAX_LEVEL> counts = ascending.levelCounts();
+    ASSERT_NEAR(counts[1], num_entries / 2, num_entries / 20);
+    ASSERT_NEAR(counts[2], num_entries / 4, num_entries / 40);
+
+    // concurrent inserts in another order build the same shape
+    SkipList concurrent{options};
+    const int num_threads = 4;
+    std::vector<std::thread> threads{};
+    for (int t = 0; t < num_threads; ++t) {
+        threads.emplace_back([&, t] {
+            for (Key key = num_entries - 1 - t; key >= 0; key -= num_threads) {
+                concurrent.insert(key, key);
+            }
+        });
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+    ASSERT_EQ(concurrent.levelCounts(), counts);
+
+    // a re-inserted key gets its old height back
+    for (Key key = 0; key < num_entries; key += 3) {
+        ASSERT_TRUE(concurrent.remove(key).has_value());
+    }
+    for (Key key = 0; key < num_entries; key += 3) {
+        ASSERT_TRUE(concurrent.insert(key, key));
+    }
+    ASSERT_EQ(concurrent.levelCounts(), counts);
+
+    // loading a snapshot and merging two halves agree with inserting
+    const auto path = std::filesystem::temp_directory_path() / "skip_list_key_hash_heights.bin";
+    ASSERT_TRUE(ascending.save(path));
+    SkipList loaded{options};
+    ASSERT_TRUE(loaded.load(path));
+    std::filesystem::remove(path);
+    ASSERT_EQ(loaded.levelCounts(), counts);
+
+    SkipList evens{options};
+    SkipList odds{options};
+    for (Key key = 0; key < num_entries; ++key) {
+        ASSERT_TRUE((key % 2 == 0 ? evens : odds).insert(key, key));
+    }
+    ASSERT_TRUE(evens.merge(std::move(odds)));
+    ASSERT_EQ(evens.levelCounts(), counts);
+
+    // another seed gives another shape
+    SkipList reseeded{{.towerHeights = TowerHeights::KeyHash, .seed = 1}};
+    for (Key key = 0; key < num_entries; ++key) {
+        ASSERT_TRUE(reseeded.insert(key, key));
+    }
+    ASSERT_NE(reseeded.levelCounts(), counts);
+}
+
+TEST(TowerHeightTest, AccessFrequencyRaisesHotKeys) {
+    const int num_entries = 100000;
+    const Key hot = 4242;
+    SkipList sl{{.augmented = true, .towerHeights = TowerHeights::AccessFrequency, .seed = 7}};
+    for (Key key = 0; key < num_entries; ++key) {
+        ASSERT_TRUE(sl.insert(key, 1));
+    }
+    size_t coldCost = sl.searchCost(hot);
+
+    std::mt19937 rng(7);
+    std::uniform_int_distribution<Key> keys{0, num_entries - 1};
+    for (int i = 0; i < 20000; ++i) {
+        matches_element(sl.find(hot), 1);
+        sl.find(keys(rng));
+    }
+    ASSERT_LT(sl.searchCost(hot), coldCost);
+    ASSERT_LE(sl.searchCost(hot), 10u);
+    ASSERT_EQ(sl.levelCounts()[0], static_cast<size_t>(num_entries));
+    ASSERT_EQ(sl.aggregate(MIN_KEY, MAX_KEY).count, static_cast<uint64_t>(num_entries));
+
+    // towers that are raised while they are removed and inserted again leave a consistent list
+    const int num_threads = 4;
+    const Key hot_keys = 8;
+    std::vector<std::thread> threads{};
+    for (int t = 0; t < num_threads; ++t) {
+        threads.emplace_back([&, t] {
+            for (int i = 0; i < 20000; ++i) {
+                Key key = i % hot_keys;
+                if (t == 0 && i % 16 == 0) {
+                    if (sl.remove(key).has_value()) {
+                        sl.insert(key, 1);
+                    }
+                } else {
+                    sl.find(key);
+                }
+            }
+        });
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+    for (Key key = 0; key < num_entries; ++key) {
+        ASSERT_TRUE(sl.find(key).has_value()) << key;
+    }
+    ASSERT_EQ(sl.size(), static_cast<size_t>(num_entries));
+    ASSERT_EQ(sl.levelCounts()[0], static_cast<size_t>(num_entries));
+    ASSERT_EQ(sl.aggregate(MIN_KEY, MAX_KEY).sum, num_entries);
+}
+
+////////////////////
+/// HANDLE TESTS ///
+////////////////////
+
+TEST(HandleTest, FindNearFinger) {
+    const int num_entries = 10000;
+    SkipList sl{};
+    SkipList::Handle handle = sl.handle();
+    for (Key key = 0; key < num_entries; ++key) {
+        ASSERT_TRUE(handle.insert(2 * key, key));
+    }
+    ASSERT_FALSE(handle.insert(0, 1));
+
+    // every find in ascending order but the first starts from the key before
+    for (Key key = 0; key < num_entries; ++key) {
+        ASSERT_EQ(handle.find(2 * key), key);
+    }
+    ASSERT_EQ(handle.stats().finds, static_cast<uint64_t>(num_entries));
+    ASSERT_EQ(handle.stats().fingerSearches, static_cast<uint64_t>(num_entries - 1));
+
+    // keys between the entries and far away from the finger
+    ASSERT_FALSE(handle.find(2 * num_entries - 3).has_value());
+    ASSERT_FALSE(handle.find(1).has_value());
+    ASSERT_EQ(handle.find(2 * num_entries - 2), num_entries - 1);
+
+    // the finger is not used once its entry is removed
+    ASSERT_EQ(handle.remove(2 * num_entries - 2), num_entries - 1);
+    ASSERT_EQ(sl.remove(2 * num_entries - 4), num_entries - 2);
+    uint64_t fingerSearches = handle.stats().fingerSearches;
+    ASSERT_FALSE(handle.find(2 * num_entries - 4).has_value());
+    ASSERT_EQ(handle.stats().fingerSearches, fingerSearches);
+    ASSERT_EQ(handle.find(2 * num_entries - 6), num_entries - 3);
+
+    // the calls without a handle see the same list
+    ASSERT_EQ(sl.find(2), 1);
+    ASSERT_FALSE(sl.find(2 * num_entries - 2).has_value());
+    ASSERT_EQ(handle.stats().inserts, static_cast<uint64_t>(num_entries));
+    ASSERT_EQ(handle.stats().removes, 1u);
+    ASSERT_EQ(sl.size(), static_cast<size_t>(num_entries - 2));
+}
+
+TEST(HandleTest, ConcurrentHandles) {
+    const int num_threads = 8;
+    const int keys_per_thread = 20000;
+    SkipList sl{{.seed = 7}};
+    std::barrier start_threads{num_threads};
+    std::vector<std::thread> threads{};
+    for (int t = 0; t < num_threads; ++t) {
+        threads.emplace_back([&, t] {
+            SkipList::Handle handle = sl.handle();
+            start_threads.arrive_and_wait();
+            for (int i = 0; i < keys_per_thread; ++i) {
+                handle.insert(i * num_threads + t, t);
+            }
+            // the finds of neighbouring keys of other threads interleave with their removes
+            for (int i = 0; i < keys_per_thread; ++i) {
+                Key key = i * num_threads + t;
+                if (i % 2 == 0) {
+                    handle.remove(key);
+                }
+                handle.find(key + 1);
+            }
+        });
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+
+    for (int t = 0; t < num_threads; ++t) {
+        for (int i = 0; i < keys_per_thread; ++i) {
+            Key key = i * num_threads + t;
+            ASSERT_EQ(sl.find(key).has_value(), i % 2 == 1) << key;
+        }
+    }
+    ASSERT_EQ(sl.size(), static_cast<size_t>(num_threads * keys_per_thread / 2));
+    ASSERT_EQ(sl.levelCounts()[0], static_cast<size_t>(num_threads * keys_per_thread / 2));
+}
+
+TEST(HandleTest, FingerAfterSplit) {
+    SkipList sl{};
+    for (Key key = 1; key <= 100; ++key) {
+        ASSERT_TRUE(sl.insert(key, key * 10));
+    }
+    // the finger of the thread is at 90, which moves to the upper list
+    ASSERT_EQ(sl.find(90), 900);
+    std::unique_ptr<SkipList> upper = sl.split_at(50);
+    ASSERT_NE(upper, nullptr);
+    ASSERT_FALSE(sl.find(95).has_value());
+    ASSERT_FALSE(sl.find(90).has_value());
+    ASSERT_EQ(sl.find(49), 490);
+    ASSERT_EQ(upper->find(95), 950);
+}
+
+TEST(HandleTest, FingerAfterMerge) {
+    SkipList a{};
+    SkipList b{};
+    for (Key key = 0; key < 20; ++key) {
+        ASSERT_TRUE((key % 2 == 0 ? a : b).insert(key, key));
+    }
+    SkipList::Handle handle = b.handle();
+    ASSERT_EQ(handle.find(11), 11);
+    ASSERT_TRUE(a.merge(std::move(b)));
+    ASSERT_FALSE(b.find(12).has_value());
+    ASSERT_FALSE(handle.find(13).has_value());
+    ASSERT_EQ(a.find(13), 13);
+}
+
+TEST(HandleTest, NestedListCallsKeepThreadHandle) {
+    // a fresh thread, so that the handles it keeps for other lists are known
+    std::thread thread([] {
+        SkipList sl{{.capacity = 1}};
+        ASSERT_TRUE(sl.insert(0, 0));
+        // the handle of sl is the next one the thread would replace
+        std::array<SkipList, 3> others{};
+        for (SkipList &other : others) {
+            other.find(0);
+        }
+        // the list of the expiry index needs a handle of its own while the insert still uses the one of sl to evict
+        ASSERT_TRUE(sl.insert(1, 1, std::chrono::hours(1)));
+        ASSERT_FALSE(sl.find(0).has_value());
+        ASSERT_EQ(sl.find(1), 1);
+        ASSERT_EQ(sl.size(), 1u);
+    });
+    thread.join();
+}
+
 int main(int argc, char** argv) {
   ::testing::InitGoogleTest(&argc, argv);
   return RUN_ALL_TESTS();
@@ -0,0 +1,530 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <numeric>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "skip_list.hpp"
+#include "transaction.hpp"
+#include "wide_index.hpp"
+#include "write_ahead_log.hpp"
+
+using Clock = std::chrono::steady_clock;
+
+namespace {
+    double secondsSince(Clock::time_point start) {
+        return std::chrono::duration<double>(Clock::now() - start).count();
+    }
+
+    // runs fn(id) on num_threads threads and returns the elapsed seconds
+    template<typename Fn>
+    double runThreads(int num_threads, Fn &&fn) {
+        std::vector<std::thread> threads{};
+        auto start = Clock::now();
+        for (int id = 0; id < num_threads; ++id) {
+            threads.emplace_back(fn, id);
+        }
+        for (auto &thread : threads) {
+            thread.join();
+        }
+        return secondsSince(start);
+    }
+
+    // hardware event counter of this process including threads started after start(), inactive if perf is unavailable
+    class PerfCounter {
+    public:
+        PerfCounter(uint32_t type, uint64_t config) {
+            perf_event_attr attr{};
+            attr.size = sizeof(attr);
+            attr.type = type;
+            attr.config = config;
+            attr.disabled = 1;
+            attr.inherit = 1;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            fd = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+        }
+
+        ~PerfCounter() {
+            if (fd >= 0) {
+                close(fd);
+            }
+        }
+
+        bool available() const {
+            return fd >= 0;
+        }
+
+        void start() {
+            if (fd >= 0) {
+                ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+                ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+            }
+        }
+
+        // counted events since start()
+        uint64_t stop() {
+            uint64_t count = 0;
+            if (fd >= 0) {
+                ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+                if (read(fd, &count, sizeof(count)) != sizeof(count)) {
+                    count = 0;
+                }
+            }
+            return count;
+        }
+
+    private:
+        int fd;
+    };
+
+    // kB of this process backed by transparent or hugetlbfs huge pages
+    uint64_t hugePageKilobytes() {
+        std::ifstream smaps("/proc/self/smaps_rollup");
+        uint64_t total = 0;
+        std::string field;
+        uint64_t kilobytes;
+        while (smaps >> field) {
+            if ((field == "AnonHugePages:" || field == "Private_Hugetlb:") && smaps >> kilobytes) {
+                total += kilobytes;
+            }
+        }
+        return total;
+    }
+}
+
+/*
+ * Durable inserts per second for different group commit batch windows.
+ */
+void benchmarkWriteAheadLog() {
+    const int num_threads = 16;
+    const int ops_per_thread = 1000;
+    const auto path = std::filesystem::temp_directory_path() / "skip_list_wal_benchmark.log";
+
+    std::cout << "write-ahead log: " << num_threads << " threads, " << ops_per_thread << " durable inserts each"
+              << std::endl;
+    std::cout << std::setw(12) << "window [us]" << std::setw(14) << "ops/s" << std::setw(10) << "syncs"
+              << std::setw(14) << "ops/sync" << std::endl;
+
+    for (int window : {0, 50, 200, 1000}) {
+        std::filesystem::remove(path);
+        auto sl = DurableSkipList::open(path, std::chrono::microseconds(window));
+        if (sl == nullptr) {
+            std::cerr << "could not open " << path << std::endl;
+            return;
+        }
+
+        double seconds = runThreads(num_threads, [&](int id) {
+            for (Key key = id; key < num_threads * ops_per_thread; key += num_threads) {
+                sl->insert(key, key);
+            }
+        });
+
+        double ops = num_threads * ops_per_thread;
+        std::cout << std::setw(12) << window << std::setw(14) << static_cast<uint64_t>(ops / seconds)
+                  << std::setw(10) << sl->log().syncs() << std::setw(14) << std::fixed << std::setprecision(1)
+                  << ops / static_cast<double>(sl->log().syncs()) << std::endl;
+    }
+    std::filesystem::remove(path);
+}
+
+/*
+ * Lookup latency of a frozen skip list with the regular one key per node index and with a wide index for every node
+ * search implementation the CPU supports.
+ */
+void benchmarkWideIndex() {
+    const int num_entries = 1000000;
+    const int num_lookups = 2000000;
+
+    // hashed heights give the list the same shape in every run
+    SkipList sl{{.towerHeights = TowerHeights::KeyHash}};
+    std::vector<SkipList::Entry> entries{};
+    for (Key key = 0; key < num_entries; ++key) {
+        sl.insert(key * 2, key);
+        entries.emplace_back(key * 2, key);
+    }
+    sl.freeze();
+
+    std::mt19937_64 rng{42};
+    std::uniform_int_distribution<Key> distribution{0, num_entries * 2};
+    std::vector<Key> lookups(num_lookups);
+    for (Key &key : lookups) {
+        key = distribution(rng);
+    }
+
+    std::cout << "wide index: " << num_entries << " entries, " << num_lookups << " random lookups" << std::endl;
+    std::cout << std::setw(12) << "index" << std::setw(14) << "ns/lookup" << std::endl;
+
+    auto measure = [&](const char *name, auto &&find) {
+        uint64_t found = 0;
+        auto start = Clock::now();
+        for (Key key : lookups) {
+            found += find(key).has_value();
+        }
+        double seconds = secondsSince(start);
+        std::cout << std::setw(12) << name << std::setw(14) << std::fixed << std::setprecision(1)
+                  << seconds * 1e9 / num_lookups << (found == 0 ? " (nothing found)" : "") << std::endl;
+    };
+
+    measure("skip list", [&](Key key) { return sl.find(key); });
+    for (auto isa : {WideIndex::Isa::Scalar, WideIndex::Isa::Avx2, WideIndex::Isa::Avx512}) {
+        if (WideIndex::supported(isa)) {
+            WideIndex index{entries, isa};
+            measure(WideIndex::name(isa), [&](Key key) { return index.find(key); });
+        }
+    }
+}
+
+/*
+ * Contended updates and lookups on a small key range, where neighbouring nodes are modified by different threads. Build
+ * with and without -DCACHE_ALIGNED_NODES=ON to compare the node layouts. Cache misses are only reported if the kernel
+ * allows perf_event_open.
+ */
+void benchmarkNodeLayout() {
+    const int key_range = 4096;
+    const int ops_per_thread = 200000;
+
+    std::cout << "node layout: " << sizeof(Node) << " bytes, aligned to " << alignof(Node) << ", " << key_range
+              << " hot keys, " << ops_per_thread << " ops per thread (50% find, 25% insert, 25% remove)" << std::endl;
+    std::cout << std::setw(10) << "threads" << std::setw(14) << "ops/s" << std::setw(16) << "cache misses/op"
+              << std::setw(16) << "L1d misses/op" << std::endl;
+
+    for (int num_threads : {1, 4, 16, 64}) {
+        SkipList sl{};
+        for (Key key = 0; key < key_range; key += 2) {
+            sl.insert(key, key);
+        }
+
+        PerfCounter cacheMisses{PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES};
+        PerfCounter l1dMisses{PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                                                  (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)};
+        cacheMisses.start();
+        l1dMisses.start();
+        double seconds = runThreads(num_threads, [&](int id) {
+            std::mt19937 rng(id);
+            std::uniform_int_distribution<Key> keys{1, key_range};
+            for (int i = 0; i < ops_per_thread; ++i) {
+                Key key = keys(rng);
+                switch (i % 4) {
+                    case 0:
+                        sl.insert(key, key);
+                        break;
+                    case 2:
+                        sl.remove(key);
+                        break;
+                    default:
+                        sl.find(key);
+                }
+            }
+        });
+        double ops = static_cast<double>(num_threads) * ops_per_thread;
+        uint64_t misses = cacheMisses.stop();
+        uint64_t l1d = l1dMisses.stop();
+
+        std::cout << std::setw(10) << num_threads << std::setw(14) << static_cast<uint64_t>(ops / seconds)
+                  << std::fixed << std::setprecision(2);
+        if (cacheMisses.available()) {
+            std::cout << std::setw(16) << misses / ops;
+        } else {
+            std::cout << std::setw(16) << "n/a";
+        }
+        if (l1dMisses.available()) {
+            std::cout << std::setw(16) << l1d / ops;
+        } else {
+            std::cout << std::setw(16) << "n/a";
+        }
+        std::cout << std::endl;
+    }
+}
+
+/*
+ * Random lookups in a large list whose nodes are spread over a lot of pages, reports the dTLB misses per lookup. Build
+ * with and without -DNODE_HUGE_PAGES=TRANSPARENT or HUGETLB to compare the page sizes. dTLB misses are only reported
+ * if the kernel allows perf_event_open.
+ */
+void benchmarkHugePages() {
+    const int num_entries = 4000000;
+    const int num_lookups = 2000000;
+
+#if defined(NODE_HUGETLB_PAGES)
+    const char *pages = "hugetlbfs";
+#elif defined(NODE_TRANSPARENT_HUGE_PAGES)
+    const char *pages = "transparent huge pages";
+#else
+    const char *pages = "regular pages";
+#endif
+    std::cout << "huge pages: nodes on " << pages << ", " << num_entries << " entries, " << num_lookups
+              << " random lookups" << std::endl;
+
+    // insert in random order, so that neighbours in the list are far apart in memory
+    std::vector<Key> keys(num_entries);
+    for (Key key = 0; key < num_entries; ++key) {
+        keys[key] = key;
+    }
+    std::mt19937_64 rng{42};
+    std::shuffle(keys.begin(), keys.end(), rng);
+    SkipList sl{};
+    for (Key key : keys) {
+        sl.insert(key, key);
+    }
+    std::uniform_int_distribution<Key> distribution{0, num_entries - 1};
+    for (Key &key : keys) {
+        key = distribution(rng);
+    }
+    keys.resize(num_lookups);
+
+    PerfCounter dtlbMisses{PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                                               (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)};
+    uint64_t found = 0;
+    dtlbMisses.start();
+    auto start = Clock::now();
+    for (Key key : keys) {
+        found += sl.find(key).has_value();
+    }
+    double seconds = secondsSince(start);
+    uint64_t misses = dtlbMisses.stop();
+
+    std::cout << std::setw(14) << "ns/lookup" << std::setw(18) << "dTLB misses/op" << std::setw(18) << "huge pages [MB]"
+              << std::endl;
+    std::cout << std::setw(14) << std::fixed << std::setprecision(1) << seconds * 1e9 / num_lookups;
+    if (dtlbMisses.available()) {
+        std::cout << std::setw(18) << std::setprecision(2) << static_cast<double>(misses) / num_lookups;
+    } else {
+        std::cout << std::setw(18) << "n/a";
+    }
+    std::cout << std::setw(18) << hugePageKilobytes() / 1024 << (found != num_lookups ? " (lookup failed)" : "")
+              << std::endl;
+}
+
+/*
+ * Overhead of transactions: updates of single keys in a regular list and in a transactional list, where every update
+ * locks the stripe of its key, and transactions that move one unit between two neighbouring keys (two updates each).
+ * Reports wall time per operation of all threads together.
+ */
+void benchmarkTransactions() {
+    const int num_keys = 100000;
+    const int ops_per_thread = 200000;
+
+    std::cout << "transactions: " << num_keys << " keys, " << ops_per_thread << " ops per thread" << std::endl;
+    std::cout << std::setw(10) << "threads" << std::setw(20) << "ns/update (plain)" << std::setw(20)
+              << "ns/update (locked)" << std::setw(18) << "ns/transaction" << std::setw(10) << "retries" << std::endl;
+
+    for (int num_threads : {1, 4, 16}) {
+        // every update removes and reinserts a random key, like a transactional update does
+        auto updates = [&](SkipList &sl) {
+            double seconds = runThreads(num_threads, [&](int id) {
+                std::mt19937 rng(id);
+                std::uniform_int_distribution<Key> keys{0, num_keys - 1};
+                for (int i = 0; i < ops_per_thread; ++i) {
+                    Key key = keys(rng);
+                    if (std::optional<Element> element = sl.remove(key); element.has_value()) {
+                        sl.insert(key, *element + 1);
+                    }
+                }
+            });
+            return seconds * 1e9 / (static_cast<double>(num_threads) * ops_per_thread);
+        };
+
+        SkipList plain{};
+        SkipList transactional{{.transactional = true}};
+        for (Key key = 0; key < num_keys; ++key) {
+            plain.insert(key, 0);
+            transactional.insert(key, 0);
+        }
+        double plainNs = updates(plain);
+        double lockedNs = updates(transactional);
+
+        std::atomic<uint64_t> retries = 0;
+        double seconds = runThreads(num_threads, [&](int id) {
+            std::mt19937 rng(id);
+            std::uniform_int_distribution<Key> keys{0, num_keys - 1};
+            for (int i = 0; i < ops_per_thread / 2; ++i) {
+                Key from = keys(rng);
+                Key to = (from + 1) % num_keys;
+                while (true) {
+                    Transaction transfer(transactional);
+                    std::optional<Element> source = transfer.find(from);
+                    std::optional<Element> target = transfer.find(to);
+                    if (!source.has_value() || !target.has_value()) {
+                        break;
+                    }
+                    transfer.update(from, *source - 1);
+                    transfer.update(to, *target + 1);
+                    if (transfer.commit()) {
+                        break;
+                    }
+                    retries++;
+                }
+            }
+        });
+        double transactionNs = seconds * 1e9 / (static_cast<double>(num_threads) * ops_per_thread / 2);
+
+        std::cout << std::setw(10) << num_threads << std::fixed << std::setprecision(1) << std::setw(20) << plainNs
+                  << std::setw(20) << lockedNs << std::setw(18) << transactionNs << std::setw(10) << retries
+                  << std::endl;
+    }
+}
+
+/*
+ * Zipf(0.99) lookups with random and with access frequency biased tower heights. The hot keys are scattered over the key
+ * range. Hops are the nodes that a search visits (SkipList::searchCost()), averaged over the measured lookups after a
+ * warm-up that lets the biased list raise the towers of the hot keys.
+ */
+void benchmarkSkewedLookups() {
+    const int num_keys = 1000000;
+    const int num_lookups = 2000000;
+    const double exponent = 0.99;
+
+    std::mt19937_64 rng{42};
+    std::vector<double> cdf(num_keys);
+    double sum = 0;
+    for (int rank = 0; rank < num_keys; ++rank) {
+        sum += 1.0 / std::pow(rank + 1, exponent);
+        cdf[rank] = sum;
+    }
+    std::vector<Key> keyOfRank(num_keys);
+    std::iota(keyOfRank.begin(), keyOfRank.end(), 0);
+    std::shuffle(keyOfRank.begin(), keyOfRank.end(), rng);
+    std::uniform_real_distribution<double> uniform{0, sum};
+    auto zipfLookups = [&]() {
+        std::vector<Key> lookups(num_lookups);
+        for (Key &key : lookups) {
+            key = keyOfRank[std::lower_bound(cdf.begin(), cdf.end(), uniform(rng)) - cdf.begin()];
+        }
+        return lookups;
+    };
+    std::vector<Key> warmup = zipfLookups();
+    std::vector<Key> lookups = zipfLookups();
+
+    std::cout << "skewed lookups: " << num_keys << " keys, " << num_lookups << " Zipf(" << exponent << ") lookups"
+              << std::endl;
+    std::cout << std::setw(12) << "heights" << std::setw(14) << "hops/lookup" << std::setw(14) << "ns/lookup"
+              << std::endl;
+
+    for (TowerHeights heights : {TowerHeights::Random, TowerHeights::AccessFrequency}) {
+        SkipList sl{{.towerHeights = heights, .seed = 42}};
+        for (Key key = 0; key < num_keys; ++key) {
+            sl.insert(key, key);
+        }
+        for (Key key : warmup) {
+            sl.find(key);
+        }
+
+        uint64_t found = 0;
+        auto start = Clock::now();
+        for (Key key : lookups) {
+            found += sl.find(key).has_value();
+        }
+        double seconds = secondsSince(start);
+        uint64_t hops = 0;
+        for (Key key : lookups) {
+            hops += sl.searchCost(key);
+        }
+        std::cout << std::setw(12) << (heights == TowerHeights::Random ? "random" : "frequency") << std::fixed
+                  << std::setprecision(1) << std::setw(14) << static_cast<double>(hops) / num_lookups
+                  << std::setw(14) << seconds * 1e9 / num_lookups
+                  << (found != num_lookups ? " (lookup failed)" : "") << std::endl;
+    }
+}
+
+/*
+ * Time per operation of all threads together, through the calls of the list and through a Handle per thread, on a list
+ * of 1M keys. Random keys mix finds, inserts and removes, ascending keys are finds of consecutive keys from a random
+ * start per thread, which are searched from the finger.
+ */
+void benchmarkHandles() {
+    const int num_keys = 1000000;
+    const int num_threads = 4;
+    const int ops_per_thread = 1000000;
+
+    std::cout << "handles: " << num_keys << " keys, " << num_threads << " threads" << std::endl;
+    std::cout << std::setw(12) << "keys" << std::setw(14) << "list ns/op" << std::setw(14) << "handle ns/op"
+              << std::endl;
+
+    for (bool ascending : {false, true}) {
+        std::cout << std::setw(12) << (ascending ? "ascending" : "random");
+        for (bool withHandle : {false, true}) {
+            SkipList sl{{.seed = 42}};
+            for (Key key = 0; key < num_keys; key += 2) {
+                sl.insert(key, key);
+            }
+            double seconds = runThreads(num_threads, [&](int id) {
+                SkipList::Handle handle = sl.handle();
+                std::mt19937_64 rng(id);
+                Key next = static_cast<Key>(rng() % num_keys);
+                for (int i = 0; i < ops_per_thread; ++i) {
+                    Key key;
+                    if (ascending) {
+                        key = next;
+                        next = (next + 1) % num_keys;
+                    } else {
+                        key = static_cast<Key>(rng() % num_keys);
+                    }
+                    // ascending keys are only looked up, random keys are inserted and removed as well
+                    uint64_t operation = ascending ? 0 : key % 4;
+                    if (operation == 1) {
+                        withHandle ? handle.insert(key, key) : sl.insert(key, key);
+                    } else if (operation == 3) {
+                        withHandle ? handle.remove(key) : sl.remove(key);
+                    } else {
+                        withHandle ? handle.find(key) : sl.find(key);
+                    }
+                }
+            });
+            std::cout << std::fixed << std::setprecision(1) << std::setw(14) << seconds * 1e9 / (num_threads * ops_per_thread);
+        }
+        std::cout << std::endl;
+    }
+}
+
+int main(int argc, char **argv) {
+    // run all benchmarks or only the ones named on the command line
+    auto selected = [&](const char *name) {
+        if (argc < 2) {
+            return true;
+        }
+        for (int i = 1; i < argc; ++i) {
+            if (std::strcmp(argv[i], name) == 0) {
+                return true;
+            }
+        }
+        return false;
+    };
+
+    if (selected("wal")) {
+        benchmarkWriteAheadLog();
+    }
+    if (selected("wide")) {
+        benchmarkWideIndex();
+    }
+    if (selected("layout")) {
+        benchmarkNodeLayout();
+    }
+    if (selected("hugepages")) {
+        benchmarkHugePages();
+    }
+    if (selected("transactions")) {
+        benchmarkTransactions();
+    }
+    if (selected("skewed")) {
+        benchmarkSkewedLookups();
+    }
+    if (selected("handles")) {
+        benchmarkHandles();
+    }
+    return 0;
+}